@@ -0,0 +1,275 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Order-preserving map of keys to dense ranks 1 .. Size(). The keys are
+// sorted together with their positions, so the ranks come out of one linear
+// pass over the sorted pairs instead of a binary search per key. Integer
+// keys are sorted by an LSD radix sort; other keys, such as floating point,
+// only need operator< and are sorted with std::sort. Append may be called
+// again with new keys: they are merged into the known ones and the earlier
+// ranks are remapped.
+template <typename Key>
+class CoordinateCompressor {
+ public:
+  using Rank = uint32_t;
+
+  // Sorting and ranking are split between up to `threads` threads.
+  explicit CoordinateCompressor(size_t threads = 1)
+      : threads_(std::max<size_t>(1, threads)) {}
+
+  // Writes the rank of keys[i] to ranks[i]; both spans have the same size.
+  // Returns `remap`, where remap[r] is the current rank of the key that had
+  // rank r before this call (remap[0] is 0).
+  std::vector<Rank> Append(std::span<const Key> keys, std::span<Rank> ranks);
+
+  // The number of distinct keys, which is also the largest rank.
+  size_t Size() const { return keys_.size(); }
+
+  // The distinct keys in order: the key of rank r is Keys()[r - 1].
+  const std::vector<Key>& Keys() const { return keys_; }
+
+  void Clear() { keys_.clear(); }
+
+ private:
+  static constexpr bool kRadix =
+      std::is_integral_v<Key> && !std::is_same_v<Key, bool>;
+  // Radix-sorted keys are stored as their unsigned images.
+  using SortKey = typename std::conditional_t<kRadix, std::make_unsigned<Key>,
+                                              std::type_identity<Key>>::type;
+  using Histogram = std::array<size_t, 256>;
+
+  static constexpr size_t kDigits = sizeof(Key);
+  // Smaller inputs are not worth starting threads for.
+  static constexpr size_t kMinSlice = 1 << 16;
+
+  struct Entry {
+    SortKey key;
+    uint32_t index;
+  };
+
+  // Flipping the sign bit orders signed keys like their unsigned images.
+  static SortKey ToSortKey(Key key) {
+    SortKey image = static_cast<SortKey>(key);
+    if constexpr (std::is_signed_v<Key>) {
+      image ^= SortKey{1} << (8 * sizeof(Key) - 1);
+    }
+    return image;
+  }
+
+  static size_t Digit(SortKey key, size_t digit) {
+    return (key >> (8 * digit)) & 255;
+  }
+
+  size_t Slices(size_t size) const {
+    return std::clamp<size_t>(size / kMinSlice, 1, threads_);
+  }
+
+  // Calls function(slice, begin, end) for `slices` contiguous parts of
+  // [0, size), each on its own thread unless there is only one.
+  template <typename Function>
+  static void ForEachSlice(size_t slices, size_t size, Function function);
+
+  std::vector<Entry> Sort(std::span<const Key> keys) const {
+    if constexpr (kRadix) {
+      return RadixSort(keys);
+    } else {
+      return ComparisonSort(keys);
+    }
+  }
+
+  std::vector<Entry> RadixSort(std::span<const Key> keys) const;
+
+  static std::vector<Entry> ComparisonSort(std::span<const Key> keys);
+
+  size_t threads_;
+  std::vector<Key> keys_;
+};
+
+template <typename Key>
+template <typename Function>
+void CoordinateCompressor<Key>::ForEachSlice(size_t slices, size_t size,
+                                             Function function) {
+  if (slices == 1) {
+    function(0, 0, size);
+    return;
+  }
+  std::vector<std::thread> workers;
+  for (size_t slice = 0; slice < slices; ++slice) {
+    workers.emplace_back(function, slice, size * slice / slices,
+                         size * (slice + 1) / slices);
+  }
+  for (auto& worker : workers) {
+    worker.join();
+  }
+}
+
+// Every slice scatters its part of a pass to offsets reserved for it, which
+// keeps the sort stable. The histograms of all digits are taken while the
+// entries are built; a digit that is the same in every key skips its pass.
+template <typename Key>
+auto CoordinateCompressor<Key>::RadixSort(std::span<const Key> keys) const
+    -> std::vector<Entry> {
+  size_t size = keys.size();
+  size_t slices = Slices(size);
+  std::vector<Entry> entries(size);
+  std::vector<std::array<Histogram, kDigits>> counts(slices);
+  ForEachSlice(slices, size, [&](size_t slice, size_t begin, size_t end) {
+    auto& count = counts[slice];
+    for (size_t i = begin; i < end; ++i) {
+      entries[i] = {ToSortKey(keys[i]), static_cast<uint32_t>(i)};
+      for (size_t digit = 0; digit < kDigits; ++digit) {
+        ++count[digit][Digit(entries[i].key, digit)];
+      }
+    }
+  });
+
+  std::vector<Entry> buffer;
+  std::vector<Histogram> offsets(slices);
+  for (size_t digit = 0; digit < kDigits && size > 0; ++digit) {
+    Histogram total{};
+    for (const auto& count : counts) {
+      for (size_t value = 0; value < total.size(); ++value) {
+        total[value] += count[digit][value];
+      }
+    }
+    if (total[Digit(entries[0].key, digit)] == size) {
+      continue;
+    }
+    // The slices hold other entries once a pass has moved them.
+    if (buffer.empty()) {
+      buffer.resize(size);
+      for (size_t slice = 0; slice < slices; ++slice) {
+        offsets[slice] = counts[slice][digit];
+      }
+    } else {
+      ForEachSlice(slices, size, [&](size_t slice, size_t begin, size_t end) {
+        offsets[slice].fill(0);
+        for (size_t i = begin; i < end; ++i) {
+          ++offsets[slice][Digit(entries[i].key, digit)];
+        }
+      });
+    }
+    size_t position = 0;
+    for (size_t value = 0; value < total.size(); ++value) {
+      for (auto& offset : offsets) {
+        size_t count = offset[value];
+        offset[value] = position;
+        position += count;
+      }
+    }
+    ForEachSlice(slices, size, [&](size_t slice, size_t begin, size_t end) {
+      auto& offset = offsets[slice];
+      for (size_t i = begin; i < end; ++i) {
+        buffer[offset[Digit(entries[i].key, digit)]++] = entries[i];
+      }
+    });
+    entries.swap(buffer);
+  }
+  return entries;
+}
+
+// Equal keys keep the order of their positions, like in the radix sort.
+template <typename Key>
+auto CoordinateCompressor<Key>::ComparisonSort(std::span<const Key> keys)
+    -> std::vector<Entry> {
+  std::vector<Entry> entries(keys.size());
+  for (size_t i = 0; i < keys.size(); ++i) {
+    entries[i] = {keys[i], static_cast<uint32_t>(i)};
+  }
+  std::sort(entries.begin(), entries.end(),
+            [](const Entry& first, const Entry& second) {
+              if (first.key < second.key || second.key < first.key) {
+                return first.key < second.key;
+              }
+              return first.index < second.index;
+            });
+  return entries;
+}
+
+// The sorted entries are ranked among the new keys alone, in parallel: a
+// slice counts where its keys change, and the prefix sums of those counts
+// give every slice its first rank. Known keys are then merged in linearly.
+template <typename Key>
+auto CoordinateCompressor<Key>::Append(std::span<const Key> keys,
+                                       std::span<Rank> ranks)
+    -> std::vector<Rank> {
+  if (keys_.size() + keys.size() > std::numeric_limits<Rank>::max()) {
+    throw std::length_error("too many keys to compress");
+  }
+  std::vector<Entry> entries = Sort(keys);
+  size_t size = entries.size();
+  size_t slices = Slices(size);
+  std::vector<size_t> first_rank(slices + 1, 0);
+  ForEachSlice(slices, size, [&](size_t slice, size_t begin, size_t end) {
+    size_t changes = 0;
+    for (size_t i = begin; i < end; ++i) {
+      changes += i == 0 || entries[i - 1].key < entries[i].key;
+    }
+    first_rank[slice + 1] = changes;
+  });
+  for (size_t slice = 0; slice < slices; ++slice) {
+    first_rank[slice + 1] += first_rank[slice];
+  }
+  std::vector<Key> added(first_rank[slices]);
+  ForEachSlice(slices, size, [&](size_t slice, size_t begin, size_t end) {
+    Rank rank = first_rank[slice];
+    for (size_t i = begin; i < end; ++i) {
+      if (i == 0 || entries[i - 1].key < entries[i].key) {
+        added[rank++] = keys[entries[i].index];
+      }
+      ranks[entries[i].index] = rank;
+    }
+  });
+
+  std::vector<Rank> remap(keys_.size() + 1, 0);
+  if (keys_.empty()) {
+    keys_ = std::move(added);
+    return remap;
+  }
+  std::vector<Rank> added_remap(added.size() + 1, 0);
+  std::vector<Key> merged;
+  merged.reserve(keys_.size() + added.size());
+  size_t old_index = 0;
+  size_t added_index = 0;
+  while (old_index < keys_.size() || added_index < added.size()) {
+    bool take_old = added_index == added.size() ||
+                    (old_index < keys_.size() &&
+                     !(added[added_index] < keys_[old_index]));
+    bool take_added = old_index == keys_.size() ||
+                      (added_index < added.size() &&
+                       !(keys_[old_index] < added[added_index]));
+    merged.push_back(take_old ? keys_[old_index] : added[added_index]);
+    if (take_old) {
+      remap[++old_index] = merged.size();
+    }
+    if (take_added) {
+      added_remap[++added_index] = merged.size();
+    }
+  }
+  keys_ = std::move(merged);
+  ForEachSlice(slices, size, [&](size_t, size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      ranks[i] = added_remap[ranks[i]];
+    }
+  });
+  return remap;
+}
+
+// One-shot compression: writes the rank of keys[i] among the distinct keys
+// to ranks[i] and returns the number of distinct keys.
+template <typename Key>
+size_t CompressCoordinates(std::span<const Key> keys, std::span<uint32_t> ranks,
+                           size_t threads = 1) {
+  CoordinateCompressor<Key> compressor(threads);
+  compressor.Append(keys, ranks);
+  return compressor.Size();
+}
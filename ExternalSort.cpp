@@ -0,0 +1,386 @@
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <future>
+#include <memory>
+#include <random>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "LsdSortBytes.cpp"
+#include "MinHeap.cpp"
+
+// External sort of a file of native-endian uint64_t values that may not fit
+// in memory: chunks of the input are sorted with LSDsort into temporary run
+// files, which are then merged with a LoserTree, in several passes if the
+// memory budget cannot hold buffers for all runs at once.
+
+struct FileCloser {
+  void operator()(std::FILE* file) const { std::fclose(file); }
+};
+
+using File = std::unique_ptr<std::FILE, FileCloser>;
+
+struct PhaseStats {
+  std::string name;
+  uint64_t bytes;
+  double seconds;
+};
+
+// Reads are done in large blocks, so stdio buffering would only add a copy.
+File OpenFile(const char* path, const char* mode) {
+  File file(std::fopen(path, mode));
+  if (file == nullptr) {
+    throw std::system_error(errno, std::generic_category(), path);
+  }
+  std::setvbuf(file.get(), nullptr, _IONBF, 0);
+  return file;
+}
+
+// A temporary run file, removed when the RunFile is destroyed. It is only
+// open while it is written or merged, so the number of open descriptors
+// does not grow with the number of runs.
+class RunFile {
+ public:
+  explicit RunFile(const std::string& directory)
+      : path_(directory + "/run-XXXXXX") {
+    int descriptor = mkstemp(path_.data());
+    if (descriptor < 0) {
+      throw std::system_error(errno, std::generic_category(), path_);
+    }
+    close(descriptor);
+  }
+
+  RunFile(RunFile&& other) noexcept : path_(std::move(other.path_)) {
+    other.path_.clear();
+  }
+
+  RunFile& operator=(RunFile&& other) noexcept {
+    if (this != &other) {
+      Remove();
+      path_ = std::move(other.path_);
+      other.path_.clear();
+    }
+    return *this;
+  }
+
+  ~RunFile() { Remove(); }
+
+  const char* Path() const { return path_.c_str(); }
+
+ private:
+  void Remove() {
+    if (!path_.empty()) {
+      unlink(path_.c_str());
+    }
+  }
+
+  std::string path_;
+};
+
+void WriteValues(std::FILE* file, const uint64_t* values, size_t count) {
+  if (std::fwrite(values, sizeof(uint64_t), count, file) != count) {
+    throw std::system_error(errno, std::generic_category(), "write");
+  }
+}
+
+// Reads up to `count` values; fewer are returned only at the end of the file.
+size_t ReadValues(std::FILE* file, uint64_t* values, size_t count) {
+  size_t read = std::fread(values, sizeof(uint64_t), count, file);
+  if (read < count && std::ferror(file)) {
+    throw std::system_error(errno, std::generic_category(), "read");
+  }
+  return read;
+}
+
+// Sequential reader of a run with one block of read-ahead: while the merge
+// consumes the front buffer, the next block is read into the back one.
+class RunReader {
+ public:
+  RunReader(std::FILE* file, size_t buffer_size)
+      : file_(file), front_(buffer_size), back_(buffer_size), position_(0) {
+    size_ = ReadValues(file_, front_.data(), front_.size());
+    if (size_ != 0) {
+      ReadAhead();
+    }
+  }
+
+  bool Done() const { return position_ == size_; }
+
+  uint64_t Current() const { return front_[position_]; }
+
+  void Advance() {
+    if (++position_ == size_) {
+      size_ = pending_.get();
+      position_ = 0;
+      front_.swap(back_);
+      if (size_ != 0) {
+        ReadAhead();
+      }
+    }
+  }
+
+ private:
+  void ReadAhead() {
+    pending_ = std::async(std::launch::async, [this] {
+      return ReadValues(file_, back_.data(), back_.size());
+    });
+  }
+
+  std::FILE* file_;
+  std::vector<uint64_t> front_;
+  std::vector<uint64_t> back_;
+  size_t size_;
+  size_t position_;
+  // Declared last so that an outstanding read finishes before the buffers
+  // are destroyed.
+  std::future<size_t> pending_;
+};
+
+// Input iterator over a RunReader, so runs can be fed to LoserTree. All
+// exhausted cursors compare equal, a default-constructed one is the end.
+class RunCursor {
+ public:
+  using iterator_category = std::input_iterator_tag;
+  using value_type = uint64_t;
+  using difference_type = std::ptrdiff_t;
+  using pointer = const uint64_t*;
+  using reference = uint64_t;
+
+  explicit RunCursor(RunReader* reader = nullptr) : reader_(reader) {}
+
+  uint64_t operator*() const { return reader_->Current(); }
+
+  RunCursor& operator++() {
+    reader_->Advance();
+    return *this;
+  }
+
+  bool operator==(const RunCursor& other) const {
+    return Exhausted() == other.Exhausted();
+  }
+
+ private:
+  bool Exhausted() const { return reader_ == nullptr || reader_->Done(); }
+
+  RunReader* reader_;
+};
+
+// Buffered writer that hands a full buffer to a background write and keeps
+// filling the other one.
+class RunWriter {
+ public:
+  RunWriter(std::FILE* file, size_t buffer_size)
+      : file_(file), front_(buffer_size), back_(buffer_size), size_(0) {}
+
+  void Write(uint64_t value) {
+    front_[size_++] = value;
+    if (size_ == front_.size()) {
+      Flush();
+    }
+  }
+
+  void Close() {
+    Flush();
+    Wait();
+  }
+
+ private:
+  void Flush() {
+    Wait();
+    front_.swap(back_);
+    pending_ = std::async(std::launch::async, WriteValues, file_,
+                          back_.data(), size_);
+    size_ = 0;
+  }
+
+  void Wait() {
+    if (pending_.valid()) {
+      pending_.get();
+    }
+  }
+
+  std::FILE* file_;
+  std::vector<uint64_t> front_;
+  std::vector<uint64_t> back_;
+  size_t size_;
+  std::future<void> pending_;
+};
+
+// Merges the runs into `output` within `memory_budget` bytes: every reader
+// and the writer get two buffers of the same size.
+void MergeRuns(const std::vector<RunFile>& runs, std::FILE* output,
+               size_t memory_budget) {
+  size_t buffer_size = std::max<size_t>(
+      1, memory_budget / ((2 * runs.size() + 2) * sizeof(uint64_t)));
+  std::vector<File> files;
+  std::vector<std::unique_ptr<RunReader>> readers;
+  std::vector<std::pair<RunCursor, RunCursor>> cursors;
+  for (const auto& run : runs) {
+    files.push_back(OpenFile(run.Path(), "rb"));
+    readers.push_back(std::make_unique<RunReader>(files.back().get(),
+                                                  buffer_size));
+    cursors.emplace_back(RunCursor(readers.back().get()), RunCursor());
+  }
+  LoserTree tree(std::move(cursors));
+  RunWriter writer(output, buffer_size);
+  for (; !tree.Empty(); tree.Pop()) {
+    writer.Write(tree.Top());
+  }
+  writer.Close();
+}
+
+template <typename Function>
+double Measure(Function function) {
+  auto start = std::chrono::steady_clock::now();
+  function();
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
+
+// Sorts `input_path` into `output_path` using about `memory_budget` bytes of
+// buffers and returns the time spent in every phase. A merge opens one file
+// per run it reads, so the fan-in is also kept below the descriptor limit.
+std::vector<PhaseStats> ExternalSort(const char* input_path,
+                                     const char* output_path,
+                                     size_t memory_budget,
+                                     const std::string& temp_directory) {
+  // LSDsort needs a scratch array as large as the chunk, and a merge reader
+  // should not get less than this to keep its reads sequential.
+  static constexpr size_t kMinMergeBuffer = 1 << 20;
+  // Descriptors left for stdio, the merge output and the library.
+  static constexpr size_t kReservedDescriptors = 8;
+  size_t chunk_size =
+      std::max<size_t>(1, memory_budget / (2 * sizeof(uint64_t)));
+  size_t max_fan_in =
+      std::max<size_t>(3, memory_budget / (2 * kMinMergeBuffer)) - 1;
+  rlimit limit;
+  if (getrlimit(RLIMIT_NOFILE, &limit) == 0 &&
+      limit.rlim_cur != RLIM_INFINITY) {
+    size_t descriptors = limit.rlim_cur;
+    size_t available = descriptors > kReservedDescriptors + 2
+                           ? descriptors - kReservedDescriptors
+                           : 2;
+    max_fan_in = std::min(max_fan_in, available);
+  }
+
+  std::vector<PhaseStats> stats;
+  std::vector<RunFile> runs;
+  File input = OpenFile(input_path, "rb");
+  uint64_t bytes = 0;
+  double seconds = Measure([&] {
+    std::vector<uint64_t> chunk;
+    while (true) {
+      chunk.resize(chunk_size);
+      size_t count = std::fread(chunk.data(), sizeof(uint64_t), chunk_size,
+                                input.get());
+      if (count == 0) {
+        break;
+      }
+      chunk.resize(count);
+      LSDsort(count, chunk);
+      runs.emplace_back(temp_directory);
+      File run = OpenFile(runs.back().Path(), "wb");
+      WriteValues(run.get(), chunk.data(), count);
+      bytes += count * sizeof(uint64_t);
+    }
+  });
+  if (std::ferror(input.get())) {
+    throw std::system_error(errno, std::generic_category(), input_path);
+  }
+  input.reset();
+  stats.push_back({"runs", bytes, seconds});
+
+  for (size_t pass = 1; runs.size() > max_fan_in; ++pass) {
+    std::vector<RunFile> merged;
+    seconds = Measure([&] {
+      for (size_t begin = 0; begin < runs.size(); begin += max_fan_in) {
+        size_t end = std::min(begin + max_fan_in, runs.size());
+        std::vector<RunFile> group(
+            std::make_move_iterator(runs.begin() + begin),
+            std::make_move_iterator(runs.begin() + end));
+        merged.emplace_back(temp_directory);
+        File output = OpenFile(merged.back().Path(), "wb");
+        MergeRuns(group, output.get(), memory_budget);
+      }
+    });
+    runs = std::move(merged);
+    stats.push_back({"merge pass " + std::to_string(pass), bytes, seconds});
+  }
+
+  File output = OpenFile(output_path, "wb");
+  seconds = Measure([&] { MergeRuns(runs, output.get(), memory_budget); });
+  if (std::fflush(output.get()) != 0) {
+    throw std::system_error(errno, std::generic_category(), output_path);
+  }
+  stats.push_back({"final merge", bytes, seconds});
+  return stats;
+}
+
+void GenerateInput(const char* path, uint64_t count) {
+  static constexpr size_t kBlock = 1 << 16;
+  File file = OpenFile(path, "wb");
+  std::mt19937_64 generator(std::random_device{}());
+  std::vector<uint64_t> block(kBlock);
+  while (count > 0) {
+    size_t size = std::min<uint64_t>(count, kBlock);
+    for (size_t i = 0; i < size; ++i) {
+      block[i] = generator();
+    }
+    WriteValues(file.get(), block.data(), size);
+    count -= size;
+  }
+}
+
+int main(int argc, char** argv) {
+  static constexpr size_t kMegabyte = 1 << 20;
+  size_t memory_budget = 256 * kMegabyte;
+  std::string temp_directory = ".";
+  const char* generate = nullptr;
+  std::vector<const char*> paths;
+  for (int i = 1; i < argc; ++i) {
+    if (std::strcmp(argv[i], "--memory") == 0 && i + 1 < argc) {
+      memory_budget = std::strtoull(argv[++i], nullptr, 10) * kMegabyte;
+    } else if (std::strcmp(argv[i], "--temp") == 0 && i + 1 < argc) {
+      temp_directory = argv[++i];
+    } else if (std::strcmp(argv[i], "--generate") == 0 && i + 1 < argc) {
+      generate = argv[++i];
+    } else {
+      paths.push_back(argv[i]);
+    }
+  }
+  if ((generate == nullptr && paths.size() != 2) ||
+      (generate != nullptr && paths.size() != 1)) {
+    std::fprintf(stderr,
+                 "usage: %s [--memory MiB] [--temp dir] input output\n"
+                 "       %s --generate count output\n",
+                 argv[0], argv[0]);
+    return 1;
+  }
+
+  try {
+    if (generate != nullptr) {
+      GenerateInput(paths[0], std::strtoull(generate, nullptr, 10));
+      return 0;
+    }
+    for (const auto& phase : ExternalSort(paths[0], paths[1], memory_budget,
+                                          temp_directory)) {
+      std::fprintf(stderr, "%s: %.3f s, %.1f MB/s\n", phase.name.c_str(),
+                   phase.seconds, phase.bytes / 1e6 / phase.seconds);
+    }
+  } catch (const std::system_error& error) {
+    std::fprintf(stderr, "%s\n", error.what());
+    return 1;
+  }
+  return 0;
+}
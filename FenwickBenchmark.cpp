@@ -0,0 +1,334 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "FenwickTree.cpp"
+
+// Benchmarks of the Fenwick tree variants, one mode per variant:
+//   2d [points] [queries]   FenwickTree2D build, updates and rectangle sums
+//   range [size] [queries]  RangeFenwickTree range adds, scalar and batched
+//                           range sums, and range sums read from PrefixSums
+//   concurrent [size] [max threads]
+//                           ConcurrentFenwickTree update throughput and
+//                           query latency against a locked FenwickTree
+//   blocked [max size] [operations]
+//                           FenwickTree against BlockedFenwickTree, with
+//                           and without huge pages, from 10^6 elements up
+//   compress [keys] [threads]
+//                           CompressCoordinates against sort and
+//                           lower_bound, with one and `threads` threads
+
+template <typename Function>
+double Measure(Function function) {
+  auto start = std::chrono::steady_clock::now();
+  function();
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
+
+void Report(const char* phase, size_t operations, double seconds) {
+  std::printf("%-24s %8.3f s %14.0f ops/s\n", phase, seconds,
+              operations / seconds);
+}
+
+size_t Argument(int argc, char** argv, int index, size_t fallback) {
+  return argc > index ? std::strtoull(argv[index], nullptr, 10) : fallback;
+}
+
+int Benchmark2D(size_t points_count, size_t queries_count) {
+  using Tree = FenwickTree2D<int64_t>;
+  constexpr int64_t kTimeRange = 1 << 30;
+  constexpr int64_t kKeyRange = 1 << 20;
+  std::mt19937_64 generator(1);
+  std::vector<Tree::Point> points(points_count);
+  for (auto& point : points) {
+    point = {static_cast<int64_t>(generator() % kTimeRange),
+             static_cast<int64_t>(generator() % kKeyRange)};
+  }
+  std::vector<Tree::Rectangle> rectangles(queries_count);
+  for (auto& rectangle : rectangles) {
+    int64_t x = generator() % kTimeRange;
+    int64_t y = generator() % kKeyRange;
+    rectangle = {x, y, x + static_cast<int64_t>(generator() % kTimeRange),
+                 y + static_cast<int64_t>(generator() % kKeyRange)};
+  }
+
+  std::optional<Tree> tree;
+  Report("build", points_count, Measure([&] { tree.emplace(points); }));
+  Report("add", points_count, Measure([&] {
+           for (const auto& point : points) {
+             tree->Add(point.first, point.second, 1);
+           }
+         }));
+  int64_t single_total = 0;
+  Report("rectangle sums", queries_count, Measure([&] {
+           for (const auto& rectangle : rectangles) {
+             single_total += tree->GetSum(rectangle);
+           }
+         }));
+  int64_t batch_total = 0;
+  Report("batched rectangle sums", queries_count, Measure([&] {
+           for (int64_t sum : tree->GetSums(rectangles)) {
+             batch_total += sum;
+           }
+         }));
+  if (single_total != batch_total) {
+    std::printf("results differ\n");
+    return 1;
+  }
+  return 0;
+}
+
+int BenchmarkRange(size_t size, size_t queries_count) {
+  using Tree = RangeFenwickTree<int64_t>;
+  std::mt19937_64 generator(1);
+  std::vector<Tree::Query> queries(queries_count);
+  for (auto& query : queries) {
+    size_t first = 1 + generator() % size;
+    size_t second = 1 + generator() % size;
+    query = {std::min(first, second), std::max(first, second)};
+  }
+
+  Tree tree(size);
+  Report("range add", queries_count, Measure([&] {
+           for (const auto& query : queries) {
+             tree.Add(query.left, query.right, 1);
+           }
+         }));
+  int64_t scalar_total = 0;
+  Report("scalar range sums", queries_count, Measure([&] {
+           for (const auto& query : queries) {
+             scalar_total += tree.GetSum(query.left, query.right);
+           }
+         }));
+  int64_t batch_total = 0;
+  Report("batched range sums", queries_count, Measure([&] {
+           for (int64_t sum : tree.GetSums(queries)) {
+             batch_total += sum;
+           }
+         }));
+  int64_t prefix_total = 0;
+  Report("prefix sums", queries_count, Measure([&] {
+           std::vector<int64_t> prefix = tree.PrefixSums();
+           for (const auto& query : queries) {
+             prefix_total += prefix[query.right] - prefix[query.left - 1];
+           }
+         }));
+  if (scalar_total != batch_total || scalar_total != prefix_total) {
+    std::printf("results differ\n");
+    return 1;
+  }
+  return 0;
+}
+
+// The baseline: one tree behind a global lock.
+class LockedFenwickTree {
+ public:
+  explicit LockedFenwickTree(size_t size) : tree_(size) {}
+
+  void Add(size_t index, int64_t incr) {
+    std::lock_guard lock(mutex_);
+    tree_.Add(index, incr);
+  }
+
+  int64_t GetSum(size_t right) {
+    std::lock_guard lock(mutex_);
+    return tree_.GetSum(right);
+  }
+
+ private:
+  std::mutex mutex_;
+  FenwickTree<int64_t> tree_;
+};
+
+// `threads` writers add for a fixed time while one extra thread issues
+// prefix sums; reports adds per second and the mean GetSum latency.
+template <typename Tree>
+void RunConcurrent(const char* name, Tree& tree, size_t size, size_t threads) {
+  constexpr auto kDuration = std::chrono::milliseconds(500);
+  std::atomic<bool> stop{false};
+  std::atomic<uint64_t> adds{0};
+  uint64_t queries = 0;
+  double query_seconds = 0;
+  std::vector<std::thread> workers;
+  for (size_t thread = 0; thread < threads; ++thread) {
+    workers.emplace_back([&, thread] {
+      std::mt19937_64 generator(thread + 1);
+      uint64_t count = 0;
+      for (; !stop.load(std::memory_order_relaxed); ++count) {
+        tree.Add(1 + generator() % size, 1);
+      }
+      adds.fetch_add(count);
+    });
+  }
+  std::thread reader([&] {
+    std::mt19937_64 generator(0);
+    int64_t total = 0;
+    query_seconds = Measure([&] {
+      for (; !stop.load(std::memory_order_relaxed); ++queries) {
+        total += tree.GetSum(1 + generator() % size);
+      }
+    });
+    std::fprintf(stderr, "%s", total < 0 ? "negative sum\n" : "");
+  });
+  std::this_thread::sleep_for(kDuration);
+  stop = true;
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  reader.join();
+  std::chrono::duration<double> seconds = kDuration;
+  std::printf("%-28s %8zu %16.0f %14.0f\n", name, threads,
+              adds / seconds.count(), 1e9 * query_seconds / queries);
+}
+
+// Adds outside 1 .. size must leave the tree unchanged and must return,
+// also while a linearizable tree holds adds back for readers.
+bool IgnoresOutOfRange(ConcurrentFenwickTree<int64_t>& tree) {
+  size_t size = tree.Size();
+  int64_t total = tree.GetSum(size);
+  tree.Add(0, 1);
+  tree.Add(size + 1, 1);
+  return tree.GetSum(size) == total;
+}
+
+int BenchmarkConcurrent(size_t size, size_t max_threads) {
+  std::printf("%-28s %8s %16s %14s\n", "tree", "threads", "adds/s",
+              "query ns");
+  for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+    LockedFenwickTree locked(size);
+    RunConcurrent("locked", locked, size, threads);
+    for (auto mode :
+         {FenwickUpdateMode::kAtomic, FenwickUpdateMode::kSharded}) {
+      for (auto consistency : {FenwickConsistency::kRelaxed,
+                               FenwickConsistency::kLinearizable}) {
+        ConcurrentFenwickTree<int64_t> tree(size, mode, consistency, threads);
+        std::string name =
+            std::string(mode == FenwickUpdateMode::kAtomic ? "atomic"
+                                                           : "sharded") +
+            (consistency == FenwickConsistency::kRelaxed ? " relaxed"
+                                                         : " linearizable");
+        RunConcurrent(name.c_str(), tree, size, threads);
+        if (!IgnoresOutOfRange(tree)) {
+          std::printf("results differ\n");
+          return 1;
+        }
+      }
+    }
+  }
+  return 0;
+}
+
+template <typename Tree>
+void RunPointOperations(const char* name, Tree& tree, size_t operations) {
+  std::mt19937_64 generator(1);
+  size_t size = tree.Size();
+  double add_seconds = Measure([&] {
+    for (size_t i = 0; i < operations; ++i) {
+      tree.Add(1 + generator() % size, 1);
+    }
+  });
+  int64_t total = 0;
+  double sum_seconds = Measure([&] {
+    for (size_t i = 0; i < operations; ++i) {
+      total += tree.GetSum(1 + generator() % size);
+    }
+  });
+  std::printf("%-20s %12zu %12.0f %12.0f %s\n", name, size,
+              1e9 * add_seconds / operations, 1e9 * sum_seconds / operations,
+              total < 0 ? "negative sum" : "");
+}
+
+int BenchmarkBlocked(size_t max_size, size_t operations) {
+  std::printf("%-20s %12s %12s %12s\n", "tree", "size", "add ns",
+              "sum ns");
+  for (size_t size = 1'000'000; size <= max_size; size *= 10) {
+    {
+      FenwickTree<int64_t> tree(size);
+      RunPointOperations("flat", tree, operations);
+    }
+    {
+      BlockedFenwickTree<int64_t> tree(size);
+      RunPointOperations("blocked", tree, operations);
+    }
+    {
+      BlockedFenwickTree<int64_t> tree(size, true);
+      RunPointOperations("blocked, huge pages", tree, operations);
+    }
+  }
+  return 0;
+}
+
+int BenchmarkCompress(size_t count, size_t threads) {
+  std::mt19937_64 generator(1);
+  std::vector<int64_t> keys(count);
+  for (auto& key : keys) {
+    key = generator() % (count / 2 + 1);
+  }
+  std::vector<uint32_t> expected(count);
+  Report("sort + lower_bound", count, Measure([&] {
+           std::vector<int64_t> sorted = keys;
+           std::sort(sorted.begin(), sorted.end());
+           sorted.erase(std::unique(sorted.begin(), sorted.end()),
+                        sorted.end());
+           for (size_t i = 0; i < count; ++i) {
+             expected[i] = std::lower_bound(sorted.begin(), sorted.end(),
+                                            keys[i]) -
+                           sorted.begin() + 1;
+           }
+         }));
+  std::vector<uint32_t> ranks(count);
+  Report("radix, 1 thread", count, Measure([&] {
+           CompressCoordinates<int64_t>(keys, ranks);
+         }));
+  bool same = ranks == expected;
+  std::string name = "radix, " + std::to_string(threads) + " threads";
+  Report(name.c_str(), count, Measure([&] {
+           CompressCoordinates<int64_t>(keys, ranks, threads);
+         }));
+  if (!same || ranks != expected) {
+    std::printf("results differ\n");
+    return 1;
+  }
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  const char* mode = argc > 1 ? argv[1] : "";
+  if (std::strcmp(mode, "2d") == 0) {
+    return Benchmark2D(Argument(argc, argv, 2, 10'000'000),
+                       Argument(argc, argv, 3, 10'000'000));
+  }
+  if (std::strcmp(mode, "range") == 0) {
+    return BenchmarkRange(Argument(argc, argv, 2, 1 << 26),
+                          Argument(argc, argv, 3, 10'000'000));
+  }
+  if (std::strcmp(mode, "concurrent") == 0) {
+    return BenchmarkConcurrent(Argument(argc, argv, 2, 1 << 20),
+                               Argument(argc, argv, 3, 64));
+  }
+  if (std::strcmp(mode, "blocked") == 0) {
+    return BenchmarkBlocked(Argument(argc, argv, 2, 1'000'000'000),
+                            Argument(argc, argv, 3, 10'000'000));
+  }
+  if (std::strcmp(mode, "compress") == 0) {
+    return BenchmarkCompress(Argument(argc, argv, 2, 100'000'000),
+                             Argument(argc, argv, 3, 8));
+  }
+  std::fprintf(stderr,
+               "usage: %s 2d|range|concurrent|blocked|compress [size] "
+               "[count]\n",
+               argv[0]);
+  return 1;
+}
@@ -1,26 +1,53 @@
+#include <sys/mman.h>
+
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <span>
+#include <thread>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+#include "CoordinateCompression.h"
+
 size_t GetLastBit(size_t number);
 
+// Fenwick tree over the indices 1 .. size; values_[0] is unused.
 template <typename T>
 class FenwickTree {
  public:
-  FenwickTree(size_t size = kCapacity) {
-    values_ = new T[kCapacity];
-    size_ = size;
+  explicit FenwickTree(size_t size) : values_(size + 1) {}
+
+  // Builds the tree in O(n); values[i] goes to index i + 1.
+  explicit FenwickTree(const std::vector<T>& values)
+      : values_(values.size() + 1) {
+    std::copy(values.begin(), values.end(), values_.begin() + 1);
+    for (size_t index = 1; index < values_.size(); ++index) {
+      size_t parent = index + GetLastBit(index);
+      if (parent < values_.size()) {
+        values_[parent] += values_[index];
+      }
+    }
   }
 
-  T GetSum(size_t right) {
-    size_t sum = 0;
+  size_t Size() const { return values_.size() - 1; }
+
+  T GetSum(size_t right) const {
+    T sum{};
     for (; right > 0; right -= GetLastBit(right)) {
       sum += values_[right];
     }
     return sum;
   }
 
-  T GetSum(size_t left, size_t right) {
+  T GetSum(size_t left, size_t right) const {
     if (right < left) {
       return 0;
     }
@@ -30,18 +57,32 @@ class FenwickTree {
     return GetSum(right) - GetSum(left - 1);
   }
 
-  void Add(size_t index, size_t incr = 1) {
-    for (; index <= size_ + 1; index += GetLastBit(index)) {
+  void Add(size_t index, T incr = 1) {
+    for (; index <= Size(); index += GetLastBit(index)) {
       values_[index] += incr;
     }
   }
 
-  ~FenwickTree() { delete[] values_; }
+  // Zeroes the tree and resizes it, keeping the memory if it is enough.
+  void Reset(size_t size) { values_.assign(size + 1, T{}); }
+
+  // The smallest index whose prefix sum is at least prefix_sum, or
+  // Size() + 1 if there is none. The elements must be non-negative. Binary
+  // lifting descends from the largest power of two, so it takes one pass
+  // over log n nodes instead of a binary search over GetSum.
+  size_t LowerBound(T prefix_sum) const {
+    size_t position = 0;
+    for (size_t step = std::bit_floor(Size()); step > 0; step >>= 1) {
+      if (position + step <= Size() && values_[position + step] < prefix_sum) {
+        position += step;
+        prefix_sum -= values_[position];
+      }
+    }
+    return position + 1;
+  }
 
  private:
-  T* values_;
-  size_t size_;
-  static constexpr size_t kCapacity = 1e7;
+  std::vector<T> values_;
 };
 
 size_t GetLastBit(size_t number) {
@@ -50,14 +91,617 @@ size_t GetLastBit(size_t number) {
   return (size_t)tmp;
 }
 
+// Offline 2D Fenwick tree for point updates and rectangle sums over points
+// that are known in advance. The outer tree runs over the distinct x; its
+// node i keeps the sorted distinct y (as ranks) of the points whose x falls
+// into the range of i, with an inner Fenwick tree over just those. Every
+// point appears in log n nodes, so memory is O(n log n) instead of a grid.
+template <typename T, typename Coordinate = int64_t>
+class FenwickTree2D {
+ public:
+  using Point = std::pair<Coordinate, Coordinate>;
+
+  // The half-open rectangle [x_begin, x_end) x [y_begin, y_end).
+  struct Rectangle {
+    Coordinate x_begin;
+    Coordinate y_begin;
+    Coordinate x_end;
+    Coordinate y_end;
+  };
+
+  explicit FenwickTree2D(std::vector<Point> points);
+
+  // (x, y) must be one of the points the tree was built from.
+  void Add(Coordinate x, Coordinate y, T delta);
+
+  // Sum over the points with x < x_end and y < y_end.
+  T GetSum(Coordinate x_end, Coordinate y_end) const;
+
+  T GetSum(const Rectangle& rectangle) const;
+
+  // Answers a batch of rectangles. Their corner queries are sorted by
+  // position, so consecutive walks visit mostly the same nodes while they
+  // are still in cache.
+  std::vector<T> GetSums(const std::vector<Rectangle>& rectangles) const;
+
+ private:
+  std::vector<Coordinate> xs_;
+  std::vector<Coordinate> ys_;
+  // Node i of the outer tree owns node_ys_ and values_ in
+  // [offsets_[i], offsets_[i + 1]), for i in 1 .. xs_.size().
+  std::vector<size_t> offsets_;
+  std::vector<uint32_t> node_ys_;
+  std::vector<T> values_;
+
+  static size_t CountLess(const std::vector<Coordinate>& sorted,
+                          Coordinate value) {
+    return std::lower_bound(sorted.begin(), sorted.end(), value) -
+           sorted.begin();
+  }
+
+  // Sum over x rank < x_count and y rank < y_count.
+  T PrefixSum(size_t x_count, uint32_t y_count) const;
+};
+
+template <typename T, typename Coordinate>
+FenwickTree2D<T, Coordinate>::FenwickTree2D(std::vector<Point> points) {
+  for (const auto& point : points) {
+    xs_.push_back(point.first);
+    ys_.push_back(point.second);
+  }
+  for (auto* axis : {&xs_, &ys_}) {
+    std::sort(axis->begin(), axis->end());
+    axis->erase(std::unique(axis->begin(), axis->end()), axis->end());
+  }
+
+  // Walking the points in order of y appends to every node in order, so the
+  // node lists come out sorted and only need duplicates removed.
+  std::sort(points.begin(), points.end(),
+            [](const Point& lhs, const Point& rhs) {
+              return lhs.second < rhs.second;
+            });
+  size_t count = xs_.size();
+  offsets_.assign(count + 2, 0);
+  for (const auto& point : points) {
+    for (size_t i = CountLess(xs_, point.first) + 1; i <= count;
+         i += GetLastBit(i)) {
+      ++offsets_[i + 1];
+    }
+  }
+  for (size_t i = 1; i <= count; ++i) {
+    offsets_[i + 1] += offsets_[i];
+  }
+  std::vector<size_t> cursors(offsets_.begin(), offsets_.end() - 1);
+  node_ys_.resize(offsets_.back());
+  for (const auto& point : points) {
+    uint32_t y = CountLess(ys_, point.second);
+    for (size_t i = CountLess(xs_, point.first) + 1; i <= count;
+         i += GetLastBit(i)) {
+      node_ys_[cursors[i]++] = y;
+    }
+  }
+
+  size_t size = 0;
+  size_t begin = offsets_[1];
+  for (size_t i = 1; i <= count; ++i) {
+    size_t end = offsets_[i + 1];
+    offsets_[i] = size;
+    for (size_t k = begin; k < end; ++k) {
+      if (k == begin || node_ys_[k] != node_ys_[k - 1]) {
+        node_ys_[size++] = node_ys_[k];
+      }
+    }
+    begin = end;
+  }
+  offsets_[count + 1] = size;
+  node_ys_.resize(size);
+  node_ys_.shrink_to_fit();
+  values_.assign(size, T{});
+}
+
+template <typename T, typename Coordinate>
+void FenwickTree2D<T, Coordinate>::Add(Coordinate x, Coordinate y, T delta) {
+  uint32_t y_rank = CountLess(ys_, y);
+  for (size_t i = CountLess(xs_, x) + 1; i < offsets_.size() - 1;
+       i += GetLastBit(i)) {
+    auto first = node_ys_.begin() + offsets_[i];
+    auto last = node_ys_.begin() + offsets_[i + 1];
+    size_t size = last - first;
+    for (size_t j = std::lower_bound(first, last, y_rank) - first + 1;
+         j <= size; j += GetLastBit(j)) {
+      values_[offsets_[i] + j - 1] += delta;
+    }
+  }
+}
+
+template <typename T, typename Coordinate>
+T FenwickTree2D<T, Coordinate>::PrefixSum(size_t x_count,
+                                          uint32_t y_count) const {
+  T sum{};
+  for (size_t i = x_count; i > 0; i -= GetLastBit(i)) {
+    auto first = node_ys_.begin() + offsets_[i];
+    auto last = node_ys_.begin() + offsets_[i + 1];
+    for (size_t j = std::lower_bound(first, last, y_count) - first; j > 0;
+         j -= GetLastBit(j)) {
+      sum += values_[offsets_[i] + j - 1];
+    }
+  }
+  return sum;
+}
+
+template <typename T, typename Coordinate>
+T FenwickTree2D<T, Coordinate>::GetSum(Coordinate x_end,
+                                       Coordinate y_end) const {
+  return PrefixSum(CountLess(xs_, x_end), CountLess(ys_, y_end));
+}
+
+template <typename T, typename Coordinate>
+T FenwickTree2D<T, Coordinate>::GetSum(const Rectangle& rectangle) const {
+  return GetSum(rectangle.x_end, rectangle.y_end) -
+         GetSum(rectangle.x_begin, rectangle.y_end) -
+         GetSum(rectangle.x_end, rectangle.y_begin) +
+         GetSum(rectangle.x_begin, rectangle.y_begin);
+}
+
+template <typename T, typename Coordinate>
+std::vector<T> FenwickTree2D<T, Coordinate>::GetSums(
+    const std::vector<Rectangle>& rectangles) const {
+  struct Corner {
+    size_t x_count;
+    uint32_t y_count;
+    bool negative;
+    size_t rectangle;
+  };
+  std::vector<Corner> corners;
+  corners.reserve(4 * rectangles.size());
+  for (size_t k = 0; k < rectangles.size(); ++k) {
+    const auto& rectangle = rectangles[k];
+    size_t x_begin = CountLess(xs_, rectangle.x_begin);
+    size_t x_end = CountLess(xs_, rectangle.x_end);
+    uint32_t y_begin = CountLess(ys_, rectangle.y_begin);
+    uint32_t y_end = CountLess(ys_, rectangle.y_end);
+    corners.push_back({x_end, y_end, false, k});
+    corners.push_back({x_begin, y_end, true, k});
+    corners.push_back({x_end, y_begin, true, k});
+    corners.push_back({x_begin, y_begin, false, k});
+  }
+  std::sort(corners.begin(), corners.end(),
+            [](const Corner& lhs, const Corner& rhs) {
+              return lhs.x_count != rhs.x_count ? lhs.x_count < rhs.x_count
+                                                : lhs.y_count < rhs.y_count;
+            });
+  std::vector<T> sums(rectangles.size());
+  for (const auto& corner : corners) {
+    T sum = PrefixSum(corner.x_count, corner.y_count);
+    if (corner.negative) {
+      sums[corner.rectangle] -= sum;
+    } else {
+      sums[corner.rectangle] += sum;
+    }
+  }
+  return sums;
+}
+
+// Fenwick tree with range updates and range sums over the indices 1 .. size.
+// Adding delta to [l, r] adds a linear function to the prefix sums: for
+// i >= l they grow by delta * i - delta * (l - 1), and from r + 1 on the
+// change is cancelled again. Two trees accumulate the slopes and the
+// offsets, so prefix(i) = slope(i) * i - offset(i). They are interleaved in
+// one array, which makes every step of a walk touch a single cache line.
+// A range [left, right] with left == 0 or right < left is empty: adding to
+// it does nothing and its sum is 0.
+template <typename T>
+class RangeFenwickTree {
+ public:
+  // Inclusive range of indices, like GetSum(left, right).
+  struct Query {
+    size_t left;
+    size_t right;
+  };
+
+  explicit RangeFenwickTree(size_t size = 0) : nodes_(size + 1) {}
+
+  size_t Size() const { return nodes_.size() - 1; }
+
+  void Add(size_t left, size_t right, T delta) {
+    if (left == 0 || right < left) {
+      return;
+    }
+    AddSuffix(left, delta, delta * static_cast<T>(left - 1));
+    AddSuffix(right + 1, -delta, -delta * static_cast<T>(right));
+  }
+
+  T GetSum(size_t right) const {
+    T slope{};
+    T offset{};
+    for (size_t index = right; index > 0; index -= GetLastBit(index)) {
+      slope += nodes_[index].slope;
+      offset += nodes_[index].offset;
+    }
+    return slope * static_cast<T>(right) - offset;
+  }
+
+  T GetSum(size_t left, size_t right) const {
+    if (left == 0 || right < left) {
+      return 0;
+    }
+    return GetSum(right) - GetSum(left - 1);
+  }
+
+  // Answers a batch of range sums. The prefix walks of kBatch queries
+  // advance in lockstep until the longest one is done; a finished walk
+  // stays on node 0, which is always zero, so a step adds to every lane
+  // without branches. The first nodes of the next group are prefetched
+  // while the current group walks.
+  std::vector<T> GetSums(std::span<const Query> queries) const;
+
+  // All prefix sums, prefix[i] for i = 0 .. size, in linear time. This pays
+  // off when a batch touches most of the array; besides the result it needs
+  // a scratch array the size of the tree.
+  std::vector<T> PrefixSums() const;
+
+ private:
+  static constexpr size_t kBatch = 4;
+  static constexpr size_t kLanes = 2 * kBatch;
+
+  struct Node {
+    T slope{};
+    T offset{};
+  };
+
+  void AddSuffix(size_t index, T slope, T offset) {
+    for (; index <= Size(); index += GetLastBit(index)) {
+      nodes_[index].slope += slope;
+      nodes_[index].offset += offset;
+    }
+  }
+
+  std::vector<Node> nodes_;
+};
+
+template <typename T>
+std::vector<T> RangeFenwickTree<T>::GetSums(
+    std::span<const Query> queries) const {
+  std::vector<T> sums(queries.size());
+  // Every query walks from right and from left - 1. Empty ranges and the
+  // lanes past the last query walk from node 0.
+  auto ends_of = [&](size_t first) {
+    std::array<size_t, kLanes> ends{};
+    for (size_t k = 0; k < kBatch && first + k < queries.size(); ++k) {
+      const Query& query = queries[first + k];
+      if (query.left != 0 && query.left <= query.right) {
+        ends[2 * k] = query.right;
+        ends[2 * k + 1] = query.left - 1;
+      }
+    }
+    return ends;
+  };
+  std::array<size_t, kLanes> next = ends_of(0);
+  for (size_t first = 0; first < queries.size(); first += kBatch) {
+    std::array<size_t, kLanes> ends = next;
+    next = ends_of(first + kBatch);
+    for (size_t end : next) {
+      __builtin_prefetch(&nodes_[end]);
+    }
+    std::array<size_t, kLanes> indices = ends;
+    std::array<Node, kLanes> totals{};
+    // The fold unrolls the lanes, which keeps them in registers.
+    [&]<size_t... kLane>(std::index_sequence<kLane...>) {
+      do {
+        ((totals[kLane].slope += nodes_[indices[kLane]].slope,
+          totals[kLane].offset += nodes_[indices[kLane]].offset,
+          indices[kLane] &= indices[kLane] - 1),
+         ...);
+      } while ((indices[kLane] | ...) != 0);
+    }(std::make_index_sequence<kLanes>());
+    size_t count = std::min(kBatch, queries.size() - first);
+    for (size_t k = 0; k < count; ++k) {
+      const Node& right = totals[2 * k];
+      const Node& left = totals[2 * k + 1];
+      sums[first + k] = (right.slope * static_cast<T>(ends[2 * k]) -
+                         right.offset) -
+                        (left.slope * static_cast<T>(ends[2 * k + 1]) -
+                         left.offset);
+    }
+  }
+  return sums;
+}
+
+// The walk from i is node i followed by the walk from i without its lowest
+// bit, which is a smaller index, so one pass in increasing order finds the
+// slope and offset sums of every walk.
+template <typename T>
+std::vector<T> RangeFenwickTree<T>::PrefixSums() const {
+  size_t size = Size();
+  std::vector<Node> walks(size + 1);
+  std::vector<T> prefix(size + 1);
+  for (size_t index = 1; index <= size; ++index) {
+    const Node& rest = walks[index & (index - 1)];
+    walks[index] = {rest.slope + nodes_[index].slope,
+                    rest.offset + nodes_[index].offset};
+    prefix[index] =
+        walks[index].slope * static_cast<T>(index) - walks[index].offset;
+  }
+  return prefix;
+}
+
+enum class FenwickUpdateMode {
+  // One tree updated with atomic fetch_add.
+  kAtomic,
+  // One tree per shard; a thread adds to its own shard and readers sum
+  // over all shards.
+  kSharded,
+};
+
+enum class FenwickConsistency {
+  // A GetSum may observe part of a concurrent Add.
+  kRelaxed,
+  // A GetSum waits until the Adds in progress are done and holds new ones
+  // back while it reads, so every sum reflects whole Adds only.
+  kLinearizable,
+};
+
+// Fenwick tree for concurrent counters. Adds never block each other; the
+// shards of kSharded are padded to whole cache lines so threads adding to
+// different shards do not share lines.
 template <typename T>
-void CompressValues(std::vector<T>& values) {
-  std::vector<T> tmp = values;
-  std::sort(tmp.begin(), tmp.end());
+class ConcurrentFenwickTree {
+ public:
+  ConcurrentFenwickTree(
+      size_t size, FenwickUpdateMode mode = FenwickUpdateMode::kAtomic,
+      FenwickConsistency consistency = FenwickConsistency::kRelaxed,
+      size_t shards = std::max(1u, std::thread::hardware_concurrency()))
+      : size_(size),
+        shards_(mode == FenwickUpdateMode::kSharded
+                    ? std::max<size_t>(shards, 1)
+                    : 1),
+        stride_(RoundUp(size + 1)),
+        linearizable_(consistency == FenwickConsistency::kLinearizable),
+        values_(AllocateLines(shards_ * stride_)),
+        writers_(std::max<size_t>(shards, 1)) {}
+
+  size_t Size() const { return size_; }
 
-  for (auto& v : values) {
-    v = std::lower_bound(tmp.begin(), tmp.end(), v) - tmp.begin() + 1;
+  void Add(size_t index, T incr = 1) {
+    if (index == 0 || index > size_) {
+      return;
+    }
+    size_t slot = ThreadSlot();
+    auto& writers = writers_[slot % writers_.size()].count;
+    if (linearizable_) {
+      EnterAdd(writers);
+    }
+    std::atomic<T>* shard = &values_[slot % shards_ * stride_];
+    for (; index <= size_; index += GetLastBit(index)) {
+      shard[index].fetch_add(incr, std::memory_order_relaxed);
+    }
+    if (linearizable_) {
+      writers.fetch_sub(1, std::memory_order_release);
+    }
   }
+
+  T GetSum(size_t right) const {
+    return Read([&] { return PrefixSum(right); });
+  }
+
+  // Both prefix walks run under one hold on the adds.
+  T GetSum(size_t left, size_t right) const {
+    if (right < left) {
+      return 0;
+    }
+    if (left == 0) {
+      return GetSum(right);
+    }
+    return Read([&] { return PrefixSum(right) - PrefixSum(left - 1); });
+  }
+
+ private:
+  static constexpr size_t kCacheLineSize = 64;
+
+  struct LineDelete {
+    void operator()(std::atomic<T>* values) const {
+      ::operator delete(values, std::align_val_t(kCacheLineSize));
+    }
+  };
+
+  using Lines = std::unique_ptr<std::atomic<T>[], LineDelete>;
+
+  // Zeroed storage starting on a cache line, so that the shards, whose
+  // strides are whole lines, never share one.
+  static Lines AllocateLines(size_t count) {
+    auto* values = static_cast<std::atomic<T>*>(::operator new(
+        count * sizeof(std::atomic<T>), std::align_val_t(kCacheLineSize)));
+    std::uninitialized_default_construct_n(values, count);
+    return Lines(values);
+  }
+
+  // Adds in progress, counted per slot so that adders do not all hit one
+  // cache line.
+  struct alignas(kCacheLineSize) WriterCount {
+    std::atomic<uint32_t> count{0};
+  };
+
+  static size_t RoundUp(size_t count) {
+    size_t per_line = std::max<size_t>(1, kCacheLineSize / sizeof(T));
+    return (count + per_line - 1) / per_line * per_line;
+  }
+
+  // Threads are numbered in order of their first Add, so up to `shards`
+  // threads get a shard and a writer count of their own.
+  static size_t ThreadSlot() {
+    static std::atomic<size_t> next_thread{0};
+    thread_local size_t thread = next_thread.fetch_add(1);
+    return thread;
+  }
+
+  // An adder announces itself and then checks for a reader, and a reader
+  // raises its flag and then checks for adders (both sequentially
+  // consistent), so they cannot miss each other. Readers win ties, which
+  // keeps a stream of adds from starving them.
+  void EnterAdd(std::atomic<uint32_t>& writers) const {
+    while (true) {
+      writers.fetch_add(1);
+      if (!reading_.load()) {
+        return;
+      }
+      writers.fetch_sub(1);
+      while (reading_.load(std::memory_order_relaxed)) {
+        std::this_thread::yield();
+      }
+    }
+  }
+
+  // Runs read() with the adds held back in kLinearizable mode.
+  template <typename Function>
+  T Read(Function read) const {
+    std::unique_lock<std::mutex> lock;
+    if (linearizable_) {
+      lock = std::unique_lock(reader_mutex_);
+      BlockAdds();
+    }
+    T sum = read();
+    if (linearizable_) {
+      reading_.store(false, std::memory_order_release);
+    }
+    return sum;
+  }
+
+  T PrefixSum(size_t right) const {
+    T sum{};
+    for (size_t shard = 0; shard < shards_; ++shard) {
+      const std::atomic<T>* values = &values_[shard * stride_];
+      for (size_t index = right; index > 0; index -= GetLastBit(index)) {
+        sum += values[index].load(std::memory_order_relaxed);
+      }
+    }
+    return sum;
+  }
+
+  void BlockAdds() const {
+    reading_.store(true);
+    for (const auto& writers : writers_) {
+      while (writers.count.load() != 0) {
+        std::this_thread::yield();
+      }
+    }
+  }
+
+  size_t size_;
+  size_t shards_;
+  size_t stride_;
+  bool linearizable_;
+  Lines values_;
+  mutable std::vector<WriterCount> writers_;
+  mutable std::atomic<bool> reading_{false};
+  mutable std::mutex reader_mutex_;
+};
+
+// Fenwick tree replacement for sizes far beyond the last-level cache, with
+// the Add/GetSum interface of FenwickTree. The elements are split into
+// cache-line blocks that store local prefix sums, the block totals form
+// the next level in the same way, and once a level is small enough a
+// FenwickTree over it stays in cache. A prefix sum reads one element per
+// level and an Add rewrites the tail of one line per level, so both touch
+// about log_B(n) lines instead of log_2(n) scattered ones.
+template <typename T>
+class BlockedFenwickTree {
+  static_assert(std::is_arithmetic_v<T>,
+                "the storage is zero-filled memory from mmap");
+
+ public:
+  explicit BlockedFenwickTree(size_t size, bool huge_pages = false)
+      : size_(size), top_(0) {
+    size_t count = size;
+    size_t total = 0;
+    while (count > kTopSize) {
+      count = (count + kBlock - 1) / kBlock;
+      offsets_.push_back(total);
+      total += count * kBlock;
+    }
+    top_.Reset(count);
+    bytes_ = std::max<size_t>(total * sizeof(T), 1);
+    void* memory = mmap(nullptr, bytes_, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+      throw std::bad_alloc();
+    }
+    if (huge_pages) {
+      madvise(memory, bytes_, MADV_HUGEPAGE);
+    }
+    values_ = static_cast<T*>(memory);
+  }
+
+  BlockedFenwickTree(const BlockedFenwickTree&) = delete;
+  BlockedFenwickTree& operator=(const BlockedFenwickTree&) = delete;
+
+  ~BlockedFenwickTree() { munmap(values_, bytes_); }
+
+  size_t Size() const { return size_; }
+
+  T GetSum(size_t right) const {
+    if (right == 0) {
+      return 0;
+    }
+    size_t position = right - 1;
+    T sum{};
+    for (size_t offset : offsets_) {
+      sum += values_[offset + position];
+      position /= kBlock;
+      if (position == 0) {
+        return sum;
+      }
+      --position;
+    }
+    return sum + top_.GetSum(position + 1);
+  }
+
+  T GetSum(size_t left, size_t right) const {
+    if (right < left) {
+      return 0;
+    }
+    if (left == 0) {
+      return GetSum(right);
+    }
+    return GetSum(right) - GetSum(left - 1);
+  }
+
+  // The tail of a block is a fixed-length loop over one line, which the
+  // compiler unrolls into vector adds.
+  void Add(size_t index, T incr = 1) {
+    if (index == 0 || index > size_) {
+      return;
+    }
+    size_t position = index - 1;
+    for (size_t offset : offsets_) {
+      T* block = values_ + offset + position / kBlock * kBlock;
+      size_t first = position % kBlock;
+      for (size_t i = 0; i < kBlock; ++i) {
+        block[i] += i >= first ? incr : T{};
+      }
+      position /= kBlock;
+    }
+    top_.Add(position + 1, incr);
+  }
+
+ private:
+  static constexpr size_t kBlock = std::max<size_t>(1, 64 / sizeof(T));
+  // FenwickTree nodes this size fit in L1 or L2.
+  static constexpr size_t kTopSize = 1 << 12;
+
+  size_t size_;
+  // Level i occupies values_[offsets_[i] ..], in blocks of kBlock.
+  std::vector<size_t> offsets_;
+  T* values_;
+  size_t bytes_;
+  FenwickTree<T> top_;
+};
+
+// Replaces every value by its rank 1 .. k among the k distinct values.
+template <typename T>
+void CompressValues(std::vector<T>& values, size_t threads = 1) {
+  std::vector<uint32_t> ranks(values.size());
+  CompressCoordinates<T>(values, ranks, threads);
+  std::copy(ranks.begin(), ranks.end(), values.begin());
 }
 
 template <typename T>
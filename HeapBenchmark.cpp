@@ -0,0 +1,74 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "MinHeap.cpp"
+
+// Nanoseconds per operation of MinHeap with arity 2, 4 and 8, for sizes
+// 10^4, 10^5, ... up to --max-size (10^8 by default):
+//   insert    n random keys into an empty heap
+//   extract   ExtractMin until a heap of n random keys is empty
+//   mixed     n Insert/ExtractMin pairs on a heap holding n keys
+
+template <typename Function>
+double Measure(Function function) {
+  auto start = std::chrono::steady_clock::now();
+  function();
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
+
+template <size_t Arity>
+void RunArity(const std::vector<uint64_t>& keys) {
+  size_t size = keys.size();
+  uint64_t total = 0;
+  MinHeap<uint64_t, Arity> heap;
+  double insert_seconds = Measure([&] {
+    for (uint64_t key : keys) {
+      heap.Insert(key);
+    }
+  });
+  double mixed_seconds = Measure([&] {
+    for (size_t i = 0; i < size; ++i) {
+      uint64_t min = *heap.ExtractMin();
+      total += min;
+      heap.Insert(min + keys[i] % 1'000'000);
+    }
+  });
+  double extract_seconds = Measure([&] {
+    while (!heap.Empty()) {
+      total += *heap.ExtractMin();
+    }
+  });
+  std::printf("%12zu %6zu %12.1f %12.1f %12.1f %s\n", size, Arity,
+              1e9 * insert_seconds / size, 1e9 * extract_seconds / size,
+              1e9 * mixed_seconds / (2 * size), total == 0 ? "empty" : "");
+}
+
+int main(int argc, char** argv) {
+  size_t max_size = 100'000'000;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (std::strcmp(argv[i], "--max-size") == 0) {
+      max_size = std::strtoull(argv[i + 1], nullptr, 10);
+    }
+  }
+
+  std::printf("%12s %6s %12s %12s %12s\n", "size", "arity", "insert ns",
+              "extract ns", "mixed ns");
+  std::mt19937_64 generator(1);
+  for (size_t size = 10'000; size <= max_size; size *= 10) {
+    std::vector<uint64_t> keys(size);
+    for (auto& key : keys) {
+      key = generator();
+    }
+    RunArity<2>(keys);
+    RunArity<4>(keys);
+    RunArity<8>(keys);
+  }
+  return 0;
+}
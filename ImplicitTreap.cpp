@@ -1,228 +1,218 @@
-#include <cstdlib>
-#include <iostream>
-#include <random>
-#include <utility>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
 
-namespace constants {
-const int64_t k_max_val = 1e9 + 1;
-}
-
-template <typename T>
-class TreapArray {
-  struct Node {
-    Node(int64_t priority, const T& value)
-        : size(1),
-          min(value),
-          priority(priority),
-          value(value),
-          left(nullptr),
-          right(nullptr) {}
-
-    int64_t size;
-    T min;
-    int64_t priority;
-    T value = 0;
-    T add = 0;
-    Node* left;
-    Node* right;
-  };
+#include "TreapArray.cpp"
 
+// Buffered reader that parses tokens in place; a token never straddles a
+// refill because at least kMaxToken bytes are kept ahead of the cursor.
+class InputReader {
  public:
-  TreapArray() : root_(nullptr) {}
+  explicit InputReader(FILE* file)
+      : file_(file), buffer_(kBufferSize), begin_(0), end_(0) {}
 
-  TreapArray(std::vector<T>& array) : root_(nullptr) {
-    for (size_t i = 0; i < array.size(); ++i) {
-      Insert(i, array[i]);
+  // Consumes `prefix` if the input starts with it.
+  bool Consume(const char* prefix, size_t size) {
+    if (!Ensure(size) || std::memcmp(&buffer_[begin_], prefix, size) != 0) {
+      return false;
     }
+    begin_ += size;
+    return true;
   }
 
-  ~TreapArray() { Clear(root_); }
-
-  int64_t Size() { return Size(root_); }
-
-  bool Empty() { return Size(root_) == 0; }
-
-  void Erase(int64_t pos) {
-    auto [left, right_with_pos] = Split(root_, pos);
-    auto [pos_tree, right] = Split(right_with_pos, 1);
-    delete pos_tree;
-    root_ = Merge(left, right);
+  char ReadChar() {
+    SkipSpaces();
+    return begin_ < end_ ? buffer_[begin_++] : '\0';
   }
 
-  void Insert(int64_t pos, const T& value) {
-    int64_t priority = distribution_(gen_);
-    Node* node = new Node(priority, value);
-    auto [first, second] = Split(root_, pos);
-    root_ = Merge(Merge(first, node), second);
-  }
-
-  T GetMin(size_t left, size_t right) {
-    auto [first, second_with_value] = Split(root_, left);
-    auto [first_with_value, second] =
-        Split(second_with_value, right + 1 - left);
-    // Push(first_with_value);
-    auto ans = first_with_value->min;
-    root_ = Merge(first, Merge(first_with_value, second));
-    return ans;
-  }
-
-  void Add(size_t left, size_t right, T increment) {
-    auto [first, second_with_value] = Split(root_, left);
-    auto [first_with_value, second] =
-        Split(second_with_value, right + 1 - left);
-    first_with_value->add += increment;
-    root_ = Merge(first, Merge(first_with_value, second));
-  }
-
-  T at(int64_t pos) {
-    auto [parent, pos_node] = Find(nullptr, root_, pos);
-    return pos_node->value;
-  }
-
-  T& operator[](int64_t pos) {
-    auto [parent, pos_node] = Find(nullptr, root_, pos);
-    return pos_node->value;
+  int64_t ReadInt() {
+    SkipSpaces();
+    Ensure(kMaxToken);
+    bool negative = begin_ < end_ && buffer_[begin_] == '-';
+    begin_ += negative;
+    uint64_t value = 0;
+    while (begin_ < end_ && buffer_[begin_] >= '0' && buffer_[begin_] <= '9') {
+      value = value * 10 + (buffer_[begin_++] - '0');
+    }
+    return negative ? -static_cast<int64_t>(value)
+                    : static_cast<int64_t>(value);
   }
 
-  void Print() {
-    for (int64_t i = 0; i < Size(root_); ++i) {
-      std::cout << at(i) << ' ';
+  // Reads a little-endian fixed-size value of the binary format.
+  template <typename V>
+  V ReadRaw() {
+    V value{};
+    if (Ensure(sizeof(V))) {
+      std::memcpy(&value, &buffer_[begin_], sizeof(V));
+      begin_ += sizeof(V);
     }
+    return value;
   }
 
  private:
-  std::pair<Node*, Node*> Find(Node* parent, Node* node, int64_t pos) {
-    Push(node);
-    if (node == nullptr) {
-      return {parent, node};
-    }
-    int64_t left_size = Size(node->left);
-    if (pos == left_size) {
-      return {parent, node};
-    }
-    if (pos < left_size) {
-      return Find(node, node->left, pos);
-    }
-    return Find(node, node->right, pos - left_size - 1);
-  }
+  static constexpr size_t kBufferSize = 1 << 16;
+  static constexpr size_t kMaxToken = 32;
 
-  void Clear(Node* node) {
-    if (node == nullptr) {
-      return;
+  void SkipSpaces() {
+    while (Ensure(1) && buffer_[begin_] <= ' ') {
+      ++begin_;
     }
-    Clear(node->left);
-    Clear(node->right);
-    delete node;
   }
 
-  Node* Merge(Node* first, Node* second) {
-    Push(first);
-    Push(second);
-    if (first == nullptr) {
-      return second;
-    }
-    if (second == nullptr) {
-      return first;
-    }
-    if (first->priority > second->priority) {
-      first->right = Merge(first->right, second);
-      Update(first);
-      return first;
+  bool Ensure(size_t count) {
+    if (end_ - begin_ >= count) {
+      return true;
     }
-    second->left = Merge(first, second->left);
-    Update(second);
-    return second;
+    std::memmove(buffer_.data(), &buffer_[begin_], end_ - begin_);
+    end_ -= begin_;
+    begin_ = 0;
+    end_ += std::fread(&buffer_[end_], 1, kBufferSize - end_, file_);
+    return end_ - begin_ >= count;
   }
 
-  std::pair<Node*, Node*> Split(Node* node, int64_t pos) {
-    if (node == nullptr) {
-      return {nullptr, nullptr};
-    }
-    Push(node);
-    int64_t left_size = Size(node->left);
-    if (pos <= left_size) {
-      auto [left, right] = Split(node->left, pos);
-      node->left = right;
-      Update(node);
-      return {left, node};
-    }
-    auto [left, right] = Split(node->right, pos - left_size - 1);
-    node->right = left;
-    Update(node);
-    return {node, right};
-  }
+  FILE* file_;
+  std::vector<char> buffer_;
+  size_t begin_;
+  size_t end_;
+};
 
-  void Update(Node* node) {
-    if (node == nullptr) {
-      return;
-    }
-    Push(node);
-    node->size = 1 + Size(node->left) + Size(node->right);
-    node->min = std::min(node->value, Min(node->left));
-    node->min = std::min(node->min, Min(node->right));
-  }
+class OutputWriter {
+ public:
+  explicit OutputWriter(FILE* file)
+      : file_(file), buffer_(kBufferSize), size_(0) {}
+
+  ~OutputWriter() { Flush(); }
 
-  void Push(Node* node) {
-    if (node == nullptr) {
-      return;
+  void WriteInt(int64_t value) {
+    if (size_ + kMaxToken > kBufferSize) {
+      Flush();
     }
-    if (node->left != nullptr) {
-      node->left->add += node->add;
+    uint64_t magnitude = value;
+    if (value < 0) {
+      buffer_[size_++] = '-';
+      magnitude = -magnitude;
     }
-    if (node->right != nullptr) {
-      node->right->add += node->add;
+    char digits[kMaxToken];
+    size_t count = 0;
+    do {
+      digits[count++] = '0' + magnitude % 10;
+      magnitude /= 10;
+    } while (magnitude != 0);
+    while (count > 0) {
+      buffer_[size_++] = digits[--count];
     }
-    node->min += node->add;
-    node->value += node->add;  //* node->size;
-    node->add = 0;
   }
 
-  T Min(Node* node) {
-    if (node == nullptr) {
-      return constants::k_max_val;
+  void WriteChar(char symbol) {
+    if (size_ == kBufferSize) {
+      Flush();
     }
-    Push(node);
-    return node->min;
+    buffer_[size_++] = symbol;
   }
 
-  int64_t Size(Node* node) {
-    if (node == nullptr) {
-      return 0;
-    }
-    return node->size;
+  void Flush() {
+    std::fwrite(buffer_.data(), 1, size_, file_);
+    size_ = 0;
   }
 
-  Node* root_;
-  std::mt19937 gen_;
-  std::uniform_int_distribution<int64_t> distribution_;
-};
+ private:
+  static constexpr size_t kBufferSize = 1 << 16;
+  static constexpr size_t kMaxToken = 24;
 
-void FastIO() {
-  std::ios::sync_with_stdio(false);
-  std::cin.tie(nullptr);
-  std::cout.tie(nullptr);
-}
+  FILE* file_;
+  std::vector<char> buffer_;
+  size_t size_;
+};
 
-template <typename T>
-void ProcessRequests(size_t count, TreapArray<T>& array) {
-  char query;
-  size_t vertex;
-  size_t id = 1;
+// Requests, one per line in the text format:
+//   + pos value   insert value before position pos
+//   - pos         erase position pos
+//   a l r delta   add delta to positions l..r
+//   ? l r         print the minimum of positions l..r
+//   @ pos         print the value at position pos
+// The binary format uses the same opcodes as single bytes followed by
+// uint32 positions and int64 values.
+template <bool kBinary, typename T>
+void ProcessRequests(size_t count, TreapArray<T>& array, InputReader& input,
+                     OutputWriter& output) {
+  auto read_index = [&input]() -> size_t {
+    return kBinary ? input.ReadRaw<uint32_t>() : input.ReadInt();
+  };
+  auto read_value = [&input]() -> T {
+    return kBinary ? input.ReadRaw<int64_t>() : input.ReadInt();
+  };
   for (size_t i = 0; i < count; ++i) {
-    std::cin >> query;
+    char query = kBinary ? input.ReadRaw<char>() : input.ReadChar();
     if (query == '+') {
-      // array.Insert()
+      size_t pos = read_index();
+      array.Insert(pos, read_value());
+    } else if (query == '-') {
+      array.Erase(read_index());
+    } else if (query == 'a') {
+      size_t left = read_index();
+      size_t right = read_index();
+      array.Add(left, right, read_value());
+    } else if (query == '?') {
+      size_t left = read_index();
+      output.WriteInt(array.GetMin(left, read_index()));
+      output.WriteChar('\n');
+    } else if (query == '@') {
+      output.WriteInt(array.at(read_index()));
+      output.WriteChar('\n');
     }
   }
-} 
-
-int main() {
-  FastIO();
-  std::vector<int32_t> data = {1, 3, 5, 9, 2, 6, 4};
-  auto lca_vertices = new TreapArray<int32_t>(data);
-
-  lca_vertices->Print();
+}
 
-  delete lca_vertices;
+// Input: "n q", the n initial values and q requests, from stdin or from a
+// recorded trace given as an argument. Binary traces start with kBinaryMagic
+// followed by uint32 n, uint32 q and n int64 values. With --stats the
+// throughput of the request loop is reported to stderr.
+int main(int argc, char** argv) {
+  static constexpr char kBinaryMagic[] = "TRPB";
+  bool stats = false;
+  const char* path = nullptr;
+  for (int i = 1; i < argc; ++i) {
+    if (std::strcmp(argv[i], "--stats") == 0) {
+      stats = true;
+    } else {
+      path = argv[i];
+    }
+  }
+  FILE* file = path == nullptr ? stdin : std::fopen(path, "rb");
+  if (file == nullptr) {
+    std::perror(path);
+    return 1;
+  }
+
+  InputReader input(file);
+  OutputWriter output(stdout);
+  bool binary = input.Consume(kBinaryMagic, sizeof(kBinaryMagic) - 1);
+  size_t count = binary ? input.ReadRaw<uint32_t>() : input.ReadInt();
+  size_t queries = binary ? input.ReadRaw<uint32_t>() : input.ReadInt();
+  std::vector<int64_t> values(count);
+  for (auto& value : values) {
+    value = binary ? input.ReadRaw<int64_t>() : input.ReadInt();
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  TreapArray<int64_t> array(values);
+  if (binary) {
+    ProcessRequests<true>(queries, array, input, output);
+  } else {
+    ProcessRequests<false>(queries, array, input, output);
+  }
+  output.Flush();
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  if (stats) {
+    std::fprintf(stderr, "%zu requests in %.3f s: %.0f requests/s\n", queries,
+                 elapsed.count(), queries / elapsed.count());
+  }
+  if (path != nullptr) {
+    std::fclose(file);
+  }
   return 0;
-}
\ No newline at end of file
+}
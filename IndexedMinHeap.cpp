@@ -0,0 +1,236 @@
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <utility>
+#include <vector>
+
+// d-ary min-heap whose elements stay addressable through handles, so a key
+// can be changed or removed in O(log n) instead of leaving stale copies
+// behind. The handle map grows with the number of live elements: ids of
+// extracted or erased elements are recycled, and a generation counter tells
+// a stale handle from the current one of the same id. Contains accepts any
+// handle; every other use of a stale handle is an error.
+template <typename T, size_t Arity = 4>
+class IndexedMinHeap {
+  static_assert(Arity >= 2, "a heap node needs at least two children");
+
+ public:
+  class Handle {
+   public:
+    Handle() = default;
+
+    bool operator==(const Handle&) const = default;
+
+   private:
+    friend class IndexedMinHeap;
+
+    Handle(uint32_t id, uint32_t generation)
+        : id_(id), generation_(generation) {}
+
+    uint32_t id_ = 0;
+    // Live ids never have generation 0, so a default handle is never valid.
+    uint32_t generation_ = 0;
+  };
+
+  Handle Insert(T key);
+
+  // Returns nullptr if the heap is empty.
+  const T* Top() const;
+
+  std::optional<T> ExtractMin();
+
+  const T& Get(Handle handle) const;
+
+  bool Contains(Handle handle) const;
+
+  // The new key must not be greater than the current one.
+  void DecreaseKey(Handle handle, T key);
+
+  // The new key must not be less than the current one.
+  void IncreaseKey(Handle handle, T key);
+
+  // Sets a key that may move either way.
+  void Update(Handle handle, T key);
+
+  T Erase(Handle handle);
+
+  size_t Size() const { return heap_.size(); }
+
+  bool Empty() const { return heap_.empty(); }
+
+  // Invalidates all handles but keeps the memory.
+  void Clear();
+
+ private:
+  static constexpr uint32_t kNoSlot = std::numeric_limits<uint32_t>::max();
+
+  struct Entry {
+    T key;
+    uint32_t id;
+  };
+
+  std::vector<Entry> heap_;
+  // Heap slot of every handle id, kNoSlot for ids on the free list.
+  std::vector<uint32_t> slot_;
+  // Bumped every time the id is freed.
+  std::vector<uint32_t> generation_;
+  std::vector<uint32_t> free_ids_;
+
+  T Remove(size_t index);
+
+  void Release(uint32_t id) {
+    slot_[id] = kNoSlot;
+    if (++generation_[id] == 0) {
+      generation_[id] = 1;
+    }
+    free_ids_.push_back(id);
+  }
+
+  void Place(size_t index, Entry entry) {
+    slot_[entry.id] = index;
+    heap_[index] = std::move(entry);
+  }
+
+  void SiftUp(size_t index);
+
+  void SiftDown(size_t index);
+};
+
+template <typename T, size_t Arity>
+auto IndexedMinHeap<T, Arity>::Insert(T key) -> Handle {
+  uint32_t id;
+  if (free_ids_.empty()) {
+    id = slot_.size();
+    slot_.push_back(kNoSlot);
+    generation_.push_back(1);
+  } else {
+    id = free_ids_.back();
+    free_ids_.pop_back();
+  }
+  heap_.push_back({std::move(key), id});
+  slot_[id] = heap_.size() - 1;
+  SiftUp(heap_.size() - 1);
+  return Handle(id, generation_[id]);
+}
+
+template <typename T, size_t Arity>
+const T* IndexedMinHeap<T, Arity>::Top() const {
+  return heap_.empty() ? nullptr : &heap_[0].key;
+}
+
+template <typename T, size_t Arity>
+std::optional<T> IndexedMinHeap<T, Arity>::ExtractMin() {
+  if (heap_.empty()) {
+    return std::nullopt;
+  }
+  return Remove(0);
+}
+
+template <typename T, size_t Arity>
+const T& IndexedMinHeap<T, Arity>::Get(Handle handle) const {
+  return heap_[slot_[handle.id_]].key;
+}
+
+template <typename T, size_t Arity>
+bool IndexedMinHeap<T, Arity>::Contains(Handle handle) const {
+  return handle.id_ < slot_.size() && slot_[handle.id_] != kNoSlot &&
+         generation_[handle.id_] == handle.generation_;
+}
+
+template <typename T, size_t Arity>
+void IndexedMinHeap<T, Arity>::DecreaseKey(Handle handle, T key) {
+  size_t index = slot_[handle.id_];
+  heap_[index].key = std::move(key);
+  SiftUp(index);
+}
+
+template <typename T, size_t Arity>
+void IndexedMinHeap<T, Arity>::IncreaseKey(Handle handle, T key) {
+  size_t index = slot_[handle.id_];
+  heap_[index].key = std::move(key);
+  SiftDown(index);
+}
+
+template <typename T, size_t Arity>
+void IndexedMinHeap<T, Arity>::Update(Handle handle, T key) {
+  if (key < Get(handle)) {
+    DecreaseKey(handle, std::move(key));
+  } else {
+    IncreaseKey(handle, std::move(key));
+  }
+}
+
+template <typename T, size_t Arity>
+T IndexedMinHeap<T, Arity>::Erase(Handle handle) {
+  return Remove(slot_[handle.id_]);
+}
+
+template <typename T, size_t Arity>
+void IndexedMinHeap<T, Arity>::Clear() {
+  for (const Entry& entry : heap_) {
+    Release(entry.id);
+  }
+  heap_.clear();
+}
+
+// The last element fills the hole and may have to move either way.
+template <typename T, size_t Arity>
+T IndexedMinHeap<T, Arity>::Remove(size_t index) {
+  T key = std::move(heap_[index].key);
+  Release(heap_[index].id);
+  if (index + 1 < heap_.size()) {
+    Entry last = std::move(heap_.back());
+    heap_.pop_back();
+    bool up = index > 0 && last.key < heap_[(index - 1) / Arity].key;
+    Place(index, std::move(last));
+    if (up) {
+      SiftUp(index);
+    } else {
+      SiftDown(index);
+    }
+  } else {
+    heap_.pop_back();
+  }
+  return key;
+}
+
+// Hole-based like MinHeap, with every move recorded in slot_.
+template <typename T, size_t Arity>
+void IndexedMinHeap<T, Arity>::SiftUp(size_t index) {
+  Entry entry = std::move(heap_[index]);
+  while (index > 0) {
+    size_t parent = (index - 1) / Arity;
+    if (!(entry.key < heap_[parent].key)) {
+      break;
+    }
+    Place(index, std::move(heap_[parent]));
+    index = parent;
+  }
+  Place(index, std::move(entry));
+}
+
+template <typename T, size_t Arity>
+void IndexedMinHeap<T, Arity>::SiftDown(size_t index) {
+  size_t size = heap_.size();
+  Entry entry = std::move(heap_[index]);
+  while (true) {
+    size_t first_child = Arity * index + 1;
+    if (first_child >= size) {
+      break;
+    }
+    size_t last_child = std::min(first_child + Arity, size);
+    size_t i_min = first_child;
+    for (size_t child = first_child + 1; child < last_child; ++child) {
+      if (heap_[child].key < heap_[i_min].key) {
+        i_min = child;
+      }
+    }
+    if (!(heap_[i_min].key < entry.key)) {
+      break;
+    }
+    Place(index, std::move(heap_[i_min]));
+    index = i_min;
+  }
+  Place(index, std::move(entry));
+}
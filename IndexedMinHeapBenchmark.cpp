@@ -0,0 +1,132 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "IndexedMinHeap.cpp"
+
+// Dijkstra on a random directed graph, once with decrease-key and once with
+// the lazy-deletion std::priority_queue it replaces.
+
+struct Graph {
+  std::vector<uint32_t> offsets;
+  std::vector<uint32_t> targets;
+  std::vector<uint32_t> weights;
+};
+
+Graph RandomGraph(uint32_t vertices, uint64_t edges) {
+  std::mt19937_64 generator(1);
+  std::vector<std::pair<uint32_t, uint32_t>> arcs(edges);
+  for (auto& arc : arcs) {
+    arc = {generator() % vertices, generator() % vertices};
+  }
+  std::sort(arcs.begin(), arcs.end());
+  Graph graph;
+  graph.offsets.assign(vertices + 1, 0);
+  for (const auto& arc : arcs) {
+    ++graph.offsets[arc.first + 1];
+    graph.targets.push_back(arc.second);
+    graph.weights.push_back(1 + generator() % 1000);
+  }
+  for (uint32_t vertex = 0; vertex < vertices; ++vertex) {
+    graph.offsets[vertex + 1] += graph.offsets[vertex];
+  }
+  return graph;
+}
+
+constexpr uint64_t kUnreachable = std::numeric_limits<uint64_t>::max();
+
+std::vector<uint64_t> DijkstraIndexed(const Graph& graph, uint32_t source,
+                                      size_t* peak) {
+  using Heap = IndexedMinHeap<std::pair<uint64_t, uint32_t>>;
+  size_t vertices = graph.offsets.size() - 1;
+  std::vector<uint64_t> distance(vertices, kUnreachable);
+  std::vector<Heap::Handle> handles(vertices);
+  Heap heap;
+  distance[source] = 0;
+  handles[source] = heap.Insert({0, source});
+  *peak = 0;
+  while (auto top = heap.ExtractMin()) {
+    uint32_t vertex = top->second;
+    for (uint32_t edge = graph.offsets[vertex];
+         edge < graph.offsets[vertex + 1]; ++edge) {
+      uint32_t target = graph.targets[edge];
+      uint64_t candidate = top->first + graph.weights[edge];
+      if (candidate < distance[target]) {
+        if (distance[target] == kUnreachable) {
+          handles[target] = heap.Insert({candidate, target});
+        } else {
+          heap.DecreaseKey(handles[target], {candidate, target});
+        }
+        distance[target] = candidate;
+      }
+    }
+    *peak = std::max(*peak, heap.Size());
+  }
+  return distance;
+}
+
+std::vector<uint64_t> DijkstraLazy(const Graph& graph, uint32_t source,
+                                   size_t* peak) {
+  using Item = std::pair<uint64_t, uint32_t>;
+  size_t vertices = graph.offsets.size() - 1;
+  std::vector<uint64_t> distance(vertices, kUnreachable);
+  std::priority_queue<Item, std::vector<Item>, std::greater<>> queue;
+  distance[source] = 0;
+  queue.push({0, source});
+  *peak = 0;
+  while (!queue.empty()) {
+    auto [dist, vertex] = queue.top();
+    queue.pop();
+    if (dist != distance[vertex]) {
+      continue;
+    }
+    for (uint32_t edge = graph.offsets[vertex];
+         edge < graph.offsets[vertex + 1]; ++edge) {
+      uint32_t target = graph.targets[edge];
+      uint64_t candidate = dist + graph.weights[edge];
+      if (candidate < distance[target]) {
+        distance[target] = candidate;
+        queue.push({candidate, target});
+      }
+    }
+    *peak = std::max(*peak, queue.size());
+  }
+  return distance;
+}
+
+int main(int argc, char** argv) {
+  uint32_t vertices = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1 << 20;
+  uint64_t edges = argc > 2 ? std::strtoull(argv[2], nullptr, 10)
+                            : 8 * static_cast<uint64_t>(vertices);
+  Graph graph = RandomGraph(vertices, edges);
+
+  size_t indexed_peak;
+  size_t lazy_peak;
+  auto start = std::chrono::steady_clock::now();
+  auto indexed = DijkstraIndexed(graph, 0, &indexed_peak);
+  auto middle = std::chrono::steady_clock::now();
+  auto lazy = DijkstraLazy(graph, 0, &lazy_peak);
+  auto end = std::chrono::steady_clock::now();
+
+  std::chrono::duration<double> indexed_time = middle - start;
+  std::chrono::duration<double> lazy_time = end - middle;
+  std::printf("vertices %u, edges %llu\n", vertices,
+              static_cast<unsigned long long>(edges));
+  std::printf("decrease-key: %.3f s, peak size %zu\n", indexed_time.count(),
+              indexed_peak);
+  std::printf("lazy deletion: %.3f s, peak size %zu\n", lazy_time.count(),
+              lazy_peak);
+  if (indexed != lazy) {
+    std::printf("distances differ\n");
+    return 1;
+  }
+  return 0;
+}
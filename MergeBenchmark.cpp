@@ -0,0 +1,124 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "MinHeap.cpp"
+
+// Benchmarks of the k-way merges, one mode per change:
+//   loser [elements]        the loser-tree Merge against the binary-heap
+//                           merge it replaced, for k = 2, 4, ... 4096 sorted
+//                           arrays holding `elements` keys in total
+//   parallel [elements] [arrays] [max threads]
+//                           ParallelMerge with 1, 2, 4, ... threads against
+//                           the single-threaded Merge
+
+template <typename Function>
+double Measure(Function function) {
+  auto start = std::chrono::steady_clock::now();
+  function();
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
+
+size_t Argument(int argc, char** argv, int index, size_t fallback) {
+  return argc > index ? std::strtoull(argv[index], nullptr, 10) : fallback;
+}
+
+// `count` sorted arrays of random keys, `elements` keys in total.
+std::vector<std::vector<uint64_t>> SortedArrays(size_t count,
+                                                size_t elements) {
+  std::mt19937_64 generator(1);
+  std::vector<std::vector<uint64_t>> arrays(count);
+  for (size_t i = 0; i < count; ++i) {
+    auto& array = arrays[i];
+    array.resize(elements * (i + 1) / count - elements * i / count);
+    for (auto& key : array) {
+      key = generator();
+    }
+    std::sort(array.begin(), array.end());
+  }
+  return arrays;
+}
+
+// The merge before the loser tree: a heap of (head, array) pairs.
+template <typename T>
+std::vector<T> HeapMerge(const std::vector<std::vector<T>>& arrays) {
+  MinHeap<std::pair<T, size_t>> heap;
+  std::vector<size_t> indexes(arrays.size(), 0);
+  size_t size = 0;
+  for (size_t i = 0; i < arrays.size(); ++i) {
+    if (!arrays[i].empty()) {
+      heap.Insert({arrays[i][0], i});
+    }
+    size += arrays[i].size();
+  }
+  std::vector<T> result;
+  result.reserve(size);
+  while (!heap.Empty()) {
+    auto [value, array] = *heap.ExtractMin();
+    result.push_back(value);
+    if (++indexes[array] < arrays[array].size()) {
+      heap.Insert({arrays[array][indexes[array]], array});
+    }
+  }
+  return result;
+}
+
+int BenchmarkLoser(size_t elements) {
+  std::printf("%8s %16s %16s\n", "k", "heap ns/elem", "loser ns/elem");
+  for (size_t count = 2; count <= 4096; count *= 2) {
+    auto arrays = SortedArrays(count, elements);
+    std::vector<uint64_t> heap_result;
+    std::vector<uint64_t> loser_result;
+    double heap_seconds = Measure([&] { heap_result = HeapMerge(arrays); });
+    double loser_seconds = Measure([&] { loser_result = Merge(arrays); });
+    std::printf("%8zu %16.1f %16.1f %s\n", count,
+                1e9 * heap_seconds / elements, 1e9 * loser_seconds / elements,
+                heap_result == loser_result ? "" : "results differ");
+  }
+  return 0;
+}
+
+int BenchmarkParallel(size_t elements, size_t count, size_t max_threads) {
+  auto arrays = SortedArrays(count, elements);
+  std::vector<uint64_t> expected;
+  double merge_seconds = Measure([&] { expected = Merge(arrays); });
+  std::printf("%8s %14s %10s\n", "threads", "ns/elem", "speedup");
+  std::printf("%8s %14.1f %10.2f\n", "Merge", 1e9 * merge_seconds / elements,
+              1.0);
+  for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+    std::vector<uint64_t> result;
+    double seconds =
+        Measure([&] { result = ParallelMerge(arrays, threads); });
+    std::printf("%8zu %14.1f %10.2f %s\n", threads, 1e9 * seconds / elements,
+                merge_seconds / seconds,
+                result == expected ? "" : "results differ");
+  }
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  const char* mode = argc > 1 ? argv[1] : "";
+  if (std::strcmp(mode, "loser") == 0) {
+    return BenchmarkLoser(Argument(argc, argv, 2, 10'000'000));
+  }
+  if (std::strcmp(mode, "parallel") == 0) {
+    size_t threads = std::max(1u, std::thread::hardware_concurrency());
+    return BenchmarkParallel(Argument(argc, argv, 2, 10'000'000),
+                             Argument(argc, argv, 3, 64),
+                             Argument(argc, argv, 4, threads));
+  }
+  std::fprintf(stderr,
+               "usage: %s loser [elements] | "
+               "parallel [elements] [arrays] [max threads]\n",
+               argv[0]);
+  return 1;
+}
@@ -1,113 +1,710 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
 #include <iostream>
+#include <iterator>
+#include <mutex>
+#include <new>
 #include <optional>
+#include <random>
+#include <thread>
+#include <utility>
 #include <vector>
 
+constexpr size_t kCacheLine = 64;
+
 template <typename T>
+struct CacheAlignedAllocator {
+  using value_type = T;
+
+  CacheAlignedAllocator() = default;
+
+  template <typename U>
+  CacheAlignedAllocator(const CacheAlignedAllocator<U>&) {}
+
+  T* allocate(size_t count) {
+    return static_cast<T*>(
+        ::operator new(count * sizeof(T), std::align_val_t(kCacheLine)));
+  }
+
+  void deallocate(T* pointer, size_t) {
+    ::operator delete(pointer, std::align_val_t(kCacheLine));
+  }
+
+  template <typename U>
+  bool operator==(const CacheAlignedAllocator<U>&) const {
+    return true;
+  }
+};
+
+// d-ary min-heap. Element i lives in data_[i + kOffset]: the shift makes
+// the children Arity * i + 1 .. Arity * i + Arity start at a multiple of
+// Arity, so in the cache-line-aligned buffer all children of a node share
+// one line whenever Arity * sizeof(T) <= kCacheLine. The vector size tracks
+// the heap size, so growing only move-constructs the existing elements.
+template <typename T, size_t Arity = 2>
 class MinHeap {
+  static_assert(Arity >= 2, "a heap node needs at least two children");
+
  public:
-  MinHeap() : data_(kCapacity), size_(0) {}
+  MinHeap();
 
-  std::optional<T> Top();
+  // Builds the heap from [first, last) in O(n); pass move iterators to
+  // move the elements in.
+  template <typename InputIt>
+  MinHeap(InputIt first, InputIt last);
+
+  template <typename InputIt>
+  void Assign(InputIt first, InputIt last);
+
+  // Returns nullptr if the heap is empty.
+  const T* Top() const;
 
   std::optional<T> ExtractMin();
 
   void Insert(T value);
 
+  // Appends [first, last) and either sifts the new elements up or rebuilds
+  // the whole heap, whichever has the smaller worst-case cost.
+  template <typename InputIt>
+  void InsertBatch(InputIt first, InputIt last);
+
+  // Moves the min(k, Size()) smallest elements to `out` in ascending order.
+  template <typename OutputIt>
+  OutputIt ExtractTopK(size_t k, OutputIt out);
+
+  size_t Size() const;
+
   bool Empty() const;
 
+  // Keeps the capacity for the next round of inserts.
+  void Clear();
+
  private:
   static constexpr size_t kCapacity = 8;
-  static constexpr size_t kTopIdx = 1;
-  std::vector<T> data_;
-  size_t size_;
+  static constexpr size_t kOffset = Arity - 1;
+  std::vector<T, CacheAlignedAllocator<T>> data_;
+
+  T& At(size_t index) { return data_[index + kOffset]; }
+
+  const T& At(size_t index) const { return data_[index + kOffset]; }
+
+  void PopTop();
+
+  void Heapify();
+
   void SiftUp(size_t index);
 
   void SiftDown(size_t index);
 };
 
-template <typename T>
-std::optional<T> MinHeap<T>::Top() {
-    if (size_ == 0) {
-      return std::nullopt;
-    }
-    return data_[kTopIdx];
+template <typename T, size_t Arity>
+MinHeap<T, Arity>::MinHeap() {
+  data_.reserve(kCapacity + kOffset);
+  data_.resize(kOffset);
+}
+
+template <typename T, size_t Arity>
+template <typename InputIt>
+MinHeap<T, Arity>::MinHeap(InputIt first, InputIt last) : MinHeap() {
+  Assign(first, last);
+}
+
+template <typename T, size_t Arity>
+template <typename InputIt>
+void MinHeap<T, Arity>::Assign(InputIt first, InputIt last) {
+  data_.resize(kOffset);
+  data_.insert(data_.end(), first, last);
+  Heapify();
+}
+
+template <typename T, size_t Arity>
+const T* MinHeap<T, Arity>::Top() const {
+  return Empty() ? nullptr : &At(0);
+}
+
+template <typename T, size_t Arity>
+std::optional<T> MinHeap<T, Arity>::ExtractMin() {
+  if (Empty()) {
+    return std::nullopt;
   }
+  std::optional<T> top(std::move(At(0)));
+  PopTop();
+  return top;
+}
 
-template <typename T>
-std::optional<T> MinHeap<T>::ExtractMin() {
-    if (size_ == 0) {
-      return std::nullopt;
-    }
-    std::swap(data_[kTopIdx], data_[size_]);
-    --size_;
-    SiftDown(kTopIdx);
-    return data_[size_ + 1];
+template <typename T, size_t Arity>
+void MinHeap<T, Arity>::Insert(T value) {
+  data_.push_back(std::move(value));
+  SiftUp(Size() - 1);
+}
+
+template <typename T, size_t Arity>
+template <typename InputIt>
+void MinHeap<T, Arity>::InsertBatch(InputIt first, InputIt last) {
+  size_t old_size = Size();
+  data_.insert(data_.end(), first, last);
+  size_t added = Size() - old_size;
+  size_t depth = 0;
+  for (size_t level = 1; level < Size(); level *= Arity) {
+    ++depth;
   }
+  if (added * depth > Size()) {
+    Heapify();
+    return;
+  }
+  for (size_t index = old_size; index < Size(); ++index) {
+    SiftUp(index);
+  }
+}
 
-template <typename T>
-void MinHeap<T>::Insert(T value) {
-    if (size_ == data_.size() - 1) {
-      data_.resize(2 * size_);
-    }
-    data_[++size_] = value;
-    SiftUp(size_);
+template <typename T, size_t Arity>
+template <typename OutputIt>
+OutputIt MinHeap<T, Arity>::ExtractTopK(size_t k, OutputIt out) {
+  for (; k > 0 && !Empty(); --k) {
+    *out++ = std::move(At(0));
+    PopTop();
   }
+  return out;
+}
 
-template <typename T>
-bool MinHeap<T>::Empty() const { return size_ == 0; }
+template <typename T, size_t Arity>
+size_t MinHeap<T, Arity>::Size() const {
+  return data_.size() - kOffset;
+}
 
-template <typename T>
-void MinHeap<T>::SiftUp(size_t index) {
-    if (index > kTopIdx) {
-      size_t parent = index / 2;
-      if (data_[index] < data_[parent]) {
-        std::swap(data_[index], data_[parent]);
-        SiftUp(parent);
+template <typename T, size_t Arity>
+bool MinHeap<T, Arity>::Empty() const {
+  return Size() == 0;
+}
+
+template <typename T, size_t Arity>
+void MinHeap<T, Arity>::Clear() {
+  data_.resize(kOffset);
+}
+
+// Removes the root, whose value has already been moved out.
+template <typename T, size_t Arity>
+void MinHeap<T, Arity>::PopTop() {
+  if (Size() > 1) {
+    At(0) = std::move(data_.back());
+    data_.pop_back();
+    SiftDown(0);
+  } else {
+    data_.pop_back();
+  }
+}
+
+// Floyd's construction: sifting down every internal node from the last one
+// up costs O(n) in total, since most nodes are close to the leaves.
+template <typename T, size_t Arity>
+void MinHeap<T, Arity>::Heapify() {
+  if (Size() < 2) {
+    return;
+  }
+  for (size_t index = (Size() - 2) / Arity + 1; index-- > 0;) {
+    SiftDown(index);
+  }
+}
+
+// Both sifts move a hole instead of swapping: the element is lifted out
+// once, the elements it passes are shifted into the hole, and it is stored
+// once at its final position.
+template <typename T, size_t Arity>
+void MinHeap<T, Arity>::SiftUp(size_t index) {
+  T value = std::move(At(index));
+  while (index > 0) {
+    size_t parent = (index - 1) / Arity;
+    if (!(value < At(parent))) {
+      break;
+    }
+    At(index) = std::move(At(parent));
+    index = parent;
+  }
+  At(index) = std::move(value);
+}
+
+template <typename T, size_t Arity>
+void MinHeap<T, Arity>::SiftDown(size_t index) {
+  size_t size = Size();
+  if (index >= size) {
+    return;
+  }
+  T value = std::move(At(index));
+  while (true) {
+    size_t first_child = Arity * index + 1;
+    if (first_child >= size) {
+      break;
+    }
+    size_t last_child = std::min(first_child + Arity, size);
+    size_t i_min = first_child;
+    for (size_t child = first_child + 1; child < last_child; ++child) {
+      if (At(child) < At(i_min)) {
+        i_min = child;
       }
     }
+    if (!(At(i_min) < value)) {
+      break;
+    }
+    At(index) = std::move(At(i_min));
+    index = i_min;
   }
+  At(index) = std::move(value);
+}
 
-template <typename T>
-void MinHeap<T>::SiftDown(size_t index) {
-    size_t i_min = index;
-    size_t i_left_child = index * 2;
-    size_t i_right_child = index * 2 + 1;
-    if (i_left_child <= size_ && data_[i_left_child] < data_[i_min]) {
-      i_min = i_left_child;
+// Loser tree over k sorted runs [first, last). Internal node i of the
+// tournament keeps the run that lost the match played there and tree_[0]
+// the overall winner, so advancing the winner replays only its leaf-to-root
+// path: one match per level. The current head of every run is cached
+// in keys_, which keeps the whole tournament in a few compact arrays.
+// Equal elements are taken from the run with the smaller index first.
+template <typename InputIt, typename Compare = std::less<>>
+class LoserTree {
+ public:
+  using value_type = typename std::iterator_traits<InputIt>::value_type;
+
+  LoserTree(std::vector<std::pair<InputIt, InputIt>> runs, Compare comp = {})
+      : runs_(std::move(runs)),
+        keys_(runs_.size()),
+        exhausted_(runs_.size()),
+        tree_(std::max<size_t>(runs_.size(), 1)),
+        comp_(comp) {
+    uint32_t count = runs_.size();
+    for (uint32_t run = 0; run < count; ++run) {
+      LoadHead(run);
     }
-    if (i_right_child <= size_ && data_[i_right_child] < data_[i_min]) {
-      i_min = i_right_child;
+    if (count <= 1) {
+      return;
     }
-    if (index != i_min) {
-      std::swap(data_[i_min], data_[index]);
-      SiftDown(i_min);
+    std::vector<uint32_t> winners(2 * count);
+    for (uint32_t run = 0; run < count; ++run) {
+      winners[count + run] = run;
     }
+    for (uint32_t node = count - 1; node > 0; --node) {
+      uint32_t left = winners[2 * node];
+      uint32_t right = winners[2 * node + 1];
+      bool left_wins = Beats(left, right);
+      winners[node] = left_wins ? left : right;
+      tree_[node] = left_wins ? right : left;
+    }
+    tree_[0] = winners[1];
+  }
+
+  bool Empty() const { return runs_.empty() || exhausted_[tree_[0]]; }
+
+  const value_type& Top() const { return keys_[tree_[0]]; }
+
+  void Pop() {
+    uint32_t winner = tree_[0];
+    ++runs_[winner].first;
+    LoadHead(winner);
+    // The outcome of a match is unpredictable, so instead of branching it
+    // is turned into a mask that selects the indices to keep.
+    for (size_t node = (winner + runs_.size()) / 2; node > 0; node /= 2) {
+      uint32_t stored = tree_[node];
+      uint32_t mask = -static_cast<uint32_t>(Beats(stored, winner));
+      tree_[node] = (winner & mask) | (stored & ~mask);
+      winner = (stored & mask) | (winner & ~mask);
+    }
+    tree_[0] = winner;
+  }
+
+ private:
+  void LoadHead(uint32_t run) {
+    exhausted_[run] = runs_[run].first == runs_[run].second;
+    if (!exhausted_[run]) {
+      keys_[run] = *runs_[run].first;
+    }
+  }
+
+  // On equal keys the run with the smaller index wins. Both comparisons are
+  // evaluated and combined with bit operations to keep the replay branch-free.
+  bool Beats(uint32_t first, uint32_t second) const {
+    bool less = comp_(keys_[first], keys_[second]);
+    bool greater = comp_(keys_[second], keys_[first]);
+    bool wins = less | (!greater & (first < second));
+    bool alive = !exhausted_[first];
+    return alive & (exhausted_[second] | wins);
   }
 
+  std::vector<std::pair<InputIt, InputIt>> runs_;
+  std::vector<value_type> keys_;
+  std::vector<uint8_t> exhausted_;
+  std::vector<uint32_t> tree_;
+  Compare comp_;
+};
+
+template <typename Ranges>
+auto MakeRuns(const Ranges& ranges) {
+  using std::begin;
+  using std::end;
+  using InputIt = decltype(begin(*begin(ranges)));
+  std::vector<std::pair<InputIt, InputIt>> runs;
+  for (const auto& range : ranges) {
+    runs.emplace_back(begin(range), end(range));
+  }
+  return runs;
+}
+
+// Merges sorted ranges, calling sink(value) for every element in order.
+template <typename Ranges, typename Sink, typename Compare = std::less<>>
+void ForEachMerged(const Ranges& ranges, Sink sink, Compare comp = {}) {
+  LoserTree tree(MakeRuns(ranges), comp);
+  for (; !tree.Empty(); tree.Pop()) {
+    sink(tree.Top());
+  }
+}
+
+template <typename Ranges, typename OutputIt, typename Compare = std::less<>>
+OutputIt MergeRanges(const Ranges& ranges, OutputIt out, Compare comp = {}) {
+  ForEachMerged(
+      ranges, [&out](const auto& value) { *out++ = value; }, comp);
+  return out;
+}
+
 template <typename T>
 std::vector<T> Merge(const std::vector<std::vector<T>>& arrays) {
-  MinHeap<std::pair<T, size_t>> hp;
-  std::vector<size_t> indexes(arrays.size(), 0);
-  size_t array_index = 0;
   size_t size = 0;
   for (auto& array : arrays) {
-    if (!array.empty()) {
-      hp.Insert({array[0], array_index});
-    }
     size += array.size();
-    ++array_index;
   }
   std::vector<T> result;
   result.reserve(size);
+  MergeRanges(arrays, std::back_inserter(result));
+  return result;
+}
+
+// Co-ranking: positions split[i] in every run such that the prefixes
+// [first, first + split[i]) hold exactly the first `rank` elements of the
+// merged output, ties going to lower-indexed runs like in LoserTree. Every
+// round takes the weighted median of the window medians as a pivot, which
+// discards at least a quarter of the remaining candidates, so it needs
+// O(log n) rounds of k binary searches.
+template <typename RandomIt, typename Compare = std::less<>>
+std::vector<size_t> CoRank(
+    const std::vector<std::pair<RandomIt, RandomIt>>& runs, size_t rank,
+    Compare comp = {}) {
+  using Value = typename std::iterator_traits<RandomIt>::value_type;
+  size_t count = runs.size();
+  std::vector<size_t> low(count, 0);
+  std::vector<size_t> high(count);
+  for (size_t i = 0; i < count; ++i) {
+    high[i] = runs[i].second - runs[i].first;
+  }
+  std::vector<size_t> less(count);
+  std::vector<size_t> less_equal(count);
+  std::vector<std::pair<const Value*, size_t>> medians;
+  while (true) {
+    medians.clear();
+    for (size_t i = 0; i < count; ++i) {
+      if (low[i] < high[i]) {
+        medians.emplace_back(&runs[i].first[low[i] + (high[i] - low[i]) / 2],
+                             high[i] - low[i]);
+      }
+    }
+    if (medians.empty()) {
+      return low;
+    }
+    std::sort(medians.begin(), medians.end(),
+              [&comp](const auto& lhs, const auto& rhs) {
+                return comp(*lhs.first, *rhs.first);
+              });
+    size_t remaining = 0;
+    for (const auto& median : medians) {
+      remaining += median.second;
+    }
+    size_t weight = 0;
+    auto median = medians.begin();
+    for (; 2 * (weight + median->second) < remaining; ++median) {
+      weight += median->second;
+    }
+    const Value pivot = *median->first;
 
-  while (!hp.Empty()) {
-    auto [value, array_i] = *hp.ExtractMin();
-    result.push_back(value);
-    ++indexes[array_i];
-    if (indexes[array_i] < arrays[array_i].size()) {
-      hp.Insert({arrays[array_i][indexes[array_i]], array_i});
+    size_t total_less = 0;
+    size_t total_less_equal = 0;
+    for (size_t i = 0; i < count; ++i) {
+      auto first = runs[i].first;
+      less[i] = std::lower_bound(first + low[i], first + high[i], pivot,
+                                 comp) - first;
+      less_equal[i] = std::upper_bound(first + less[i], first + high[i],
+                                       pivot, comp) - first;
+      total_less += less[i];
+      total_less_equal += less_equal[i];
     }
+    if (rank < total_less) {
+      high = less;
+    } else if (rank > total_less_equal) {
+      low = less_equal;
+    } else {
+      size_t ties = rank - total_less;
+      for (size_t i = 0; i < count; ++i) {
+        size_t taken = std::min(ties, less_equal[i] - less[i]);
+        less[i] += taken;
+        ties -= taken;
+      }
+      return less;
+    }
+  }
+}
+
+// Merges the runs into [out, out + total) on `threads` threads. The output
+// is cut into equal slices whose run boundaries are found with CoRank, so
+// every thread merges its own slice without any coordination.
+template <typename RandomIt, typename OutputIt, typename Compare = std::less<>>
+void ParallelMerge(const std::vector<std::pair<RandomIt, RandomIt>>& runs,
+                   OutputIt out, size_t threads, Compare comp = {}) {
+  size_t total = 0;
+  for (const auto& run : runs) {
+    total += run.second - run.first;
+  }
+  threads = std::max<size_t>(1, std::min(threads, total));
+  std::vector<std::vector<size_t>> splits(threads + 1);
+  splits.back().resize(runs.size());
+  for (size_t i = 0; i < runs.size(); ++i) {
+    splits.back()[i] = runs[i].second - runs[i].first;
+  }
+  splits.front().assign(runs.size(), 0);
+
+  auto merge_slice = [&](size_t slice) {
+    std::vector<std::pair<RandomIt, RandomIt>> slice_runs;
+    slice_runs.reserve(runs.size());
+    for (size_t i = 0; i < runs.size(); ++i) {
+      slice_runs.emplace_back(runs[i].first + splits[slice][i],
+                              runs[i].first + splits[slice + 1][i]);
+    }
+    OutputIt slice_out = out + total * slice / threads;
+    LoserTree tree(std::move(slice_runs), comp);
+    for (; !tree.Empty(); tree.Pop()) {
+      *slice_out++ = tree.Top();
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for (size_t slice = 1; slice < threads; ++slice) {
+    workers.emplace_back([&, slice] {
+      splits[slice] = CoRank(runs, total * slice / threads, comp);
+    });
+  }
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  workers.clear();
+  for (size_t slice = 1; slice < threads; ++slice) {
+    workers.emplace_back(merge_slice, slice);
+  }
+  merge_slice(0);
+  for (auto& worker : workers) {
+    worker.join();
   }
+}
 
+template <typename T>
+std::vector<T> ParallelMerge(
+    const std::vector<std::vector<T>>& arrays,
+    size_t threads = std::max(1u, std::thread::hardware_concurrency())) {
+  using ConstIt = typename std::vector<T>::const_iterator;
+  std::vector<std::pair<ConstIt, ConstIt>> runs;
+  size_t size = 0;
+  for (const auto& array : arrays) {
+    runs.emplace_back(array.begin(), array.end());
+    size += array.size();
+  }
+  std::vector<T> result(size);
+  ParallelMerge(runs, result.begin(), threads);
   return result;
 }
+
+// Relaxed concurrent priority queue: a set of lock-protected MinHeap shards.
+// Insert goes to a random shard, ExtractMin samples two random shards and
+// pops the smaller top, so the result is close to, but not always, the
+// global minimum while threads rarely contend for the same lock.
+template <typename T, size_t Arity = 4>
+class MultiQueue {
+ public:
+  explicit MultiQueue(
+      size_t shards = 2 * std::max(1u, std::thread::hardware_concurrency()))
+      : shards_(std::max<size_t>(shards, 2)) {}
+
+  void Insert(T value);
+
+  // Returns std::nullopt only if every shard was seen empty.
+  std::optional<T> ExtractMin();
+
+  // A copy of the smaller top of two random shards; like ExtractMin it
+  // returns std::nullopt only if every shard was seen empty.
+  std::optional<T> Top();
+
+  bool Empty() const;
+
+  // Per-thread insertion buffer: values are kept locally and moved to one
+  // random shard in a single InsertBatch, taking a lock per batch instead
+  // of per value. Buffered values are not visible to ExtractMin until
+  // Flush, which also runs on destruction.
+  class Handle {
+   public:
+    explicit Handle(MultiQueue& queue, size_t capacity = 64)
+        : queue_(queue), capacity_(capacity) {
+      buffer_.reserve(capacity_);
+    }
+
+    Handle(const Handle&) = delete;
+    Handle& operator=(const Handle&) = delete;
+
+    ~Handle() { Flush(); }
+
+    void Insert(T value) {
+      buffer_.push_back(std::move(value));
+      if (buffer_.size() == capacity_) {
+        Flush();
+      }
+    }
+
+    std::optional<T> ExtractMin() {
+      Flush();
+      return queue_.ExtractMin();
+    }
+
+    void Flush() {
+      if (!buffer_.empty()) {
+        queue_.InsertBatch(buffer_);
+        buffer_.clear();
+      }
+    }
+
+   private:
+    MultiQueue& queue_;
+    size_t capacity_;
+    std::vector<T> buffer_;
+  };
+
+ private:
+  struct alignas(kCacheLine) Shard {
+    std::mutex mutex;
+    MinHeap<T, Arity> heap;
+  };
+
+  std::vector<Shard> shards_;
+  std::atomic<size_t> size_{0};
+
+  static std::minstd_rand& Generator() {
+    thread_local std::minstd_rand generator(
+        std::hash<std::thread::id>()(std::this_thread::get_id()));
+    return generator;
+  }
+
+  size_t RandomShard() { return Generator()() % shards_.size(); }
+
+  void InsertBatch(std::vector<T>& values);
+
+  // Locks two distinct random shards, retrying on contention; the caller
+  // unlocks them.
+  std::pair<Shard*, Shard*> LockTwo();
+
+  // The shard with the smaller top, or nullptr if both are empty.
+  static Shard* Smaller(Shard* first, Shard* second);
+};
+
+template <typename T, size_t Arity>
+void MultiQueue<T, Arity>::Insert(T value) {
+  while (true) {
+    Shard& shard = shards_[RandomShard()];
+    if (shard.mutex.try_lock()) {
+      shard.heap.Insert(std::move(value));
+      shard.mutex.unlock();
+      break;
+    }
+  }
+  size_.fetch_add(1, std::memory_order_relaxed);
+}
+
+template <typename T, size_t Arity>
+void MultiQueue<T, Arity>::InsertBatch(std::vector<T>& values) {
+  while (true) {
+    Shard& shard = shards_[RandomShard()];
+    if (shard.mutex.try_lock()) {
+      shard.heap.InsertBatch(std::make_move_iterator(values.begin()),
+                             std::make_move_iterator(values.end()));
+      shard.mutex.unlock();
+      break;
+    }
+  }
+  size_.fetch_add(values.size(), std::memory_order_relaxed);
+}
+
+template <typename T, size_t Arity>
+std::optional<T> MultiQueue<T, Arity>::ExtractMin() {
+  auto [first, second] = LockTwo();
+  Shard* shard = Smaller(first, second);
+  std::optional<T> top;
+  if (shard != nullptr) {
+    top = shard->heap.ExtractMin();
+  }
+  first->mutex.unlock();
+  second->mutex.unlock();
+  if (!top) {
+    // Both samples were empty: fall back to a scan so that a non-empty
+    // queue never reports nullopt.
+    for (auto& candidate : shards_) {
+      std::lock_guard lock(candidate.mutex);
+      if ((top = candidate.heap.ExtractMin())) {
+        break;
+      }
+    }
+  }
+  if (top) {
+    size_.fetch_sub(1, std::memory_order_relaxed);
+  }
+  return top;
+}
+
+template <typename T, size_t Arity>
+std::optional<T> MultiQueue<T, Arity>::Top() {
+  auto [first, second] = LockTwo();
+  Shard* shard = Smaller(first, second);
+  std::optional<T> top;
+  if (shard != nullptr) {
+    top = *shard->heap.Top();
+  }
+  first->mutex.unlock();
+  second->mutex.unlock();
+  if (!top) {
+    for (auto& candidate : shards_) {
+      std::lock_guard lock(candidate.mutex);
+      if (const T* candidate_top = candidate.heap.Top()) {
+        top = *candidate_top;
+        break;
+      }
+    }
+  }
+  return top;
+}
+
+template <typename T, size_t Arity>
+bool MultiQueue<T, Arity>::Empty() const {
+  return size_.load(std::memory_order_relaxed) == 0;
+}
+
+template <typename T, size_t Arity>
+auto MultiQueue<T, Arity>::LockTwo() -> std::pair<Shard*, Shard*> {
+  while (true) {
+    size_t first = RandomShard();
+    size_t second = RandomShard();
+    if (first == second) {
+      continue;
+    }
+    if (std::try_lock(shards_[first].mutex, shards_[second].mutex) == -1) {
+      return {&shards_[first], &shards_[second]};
+    }
+  }
+}
+
+template <typename T, size_t Arity>
+auto MultiQueue<T, Arity>::Smaller(Shard* first, Shard* second) -> Shard* {
+  const T* first_top = first->heap.Top();
+  const T* second_top = second->heap.Top();
+  if (first_top == nullptr) {
+    return second_top == nullptr ? nullptr : second;
+  }
+  return second_top != nullptr && *second_top < *first_top ? second : first;
+}
@@ -1,184 +1,612 @@
-#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
 #include <optional>
+#include <random>
 #include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
-struct Element {
-  long long val;
-  size_t query_id;
+// Min-max heap in one array: nodes on even levels (the root is level 0) are
+// not greater than anything in their subtree and nodes on odd levels are not
+// less. The minimum is the root and the maximum is one of its children, so
+// both ends are available without a second heap or any cross-references.
+template <typename T>
+class MinMaxHeap {
+ public:
+  std::optional<T> GetMin() const;
+
+  std::optional<T> GetMax() const;
+
+  std::optional<T> ExtractMin();
+
+  std::optional<T> ExtractMax();
+
+  void Insert(T value);
+
+  size_t Size() const { return data_.size(); }
+
+  bool Empty() const { return data_.empty(); }
+
+  // Keeps the capacity for the next round of inserts.
+  void Clear() { data_.clear(); }
+
+ private:
+  std::vector<T> data_;
+
+  static bool IsMinLevel(size_t index) {
+    return std::bit_width(index + 1) % 2 == 1;
+  }
+
+  size_t MaxIndex() const;
+
+  std::optional<T> Extract(size_t index);
+
+  // kMin selects the ordering of the levels being walked: with kMin the
+  // smaller element wins, otherwise the larger one.
+  template <bool kMin>
+  static bool Better(const T& first, const T& second) {
+    return kMin ? first < second : second < first;
+  }
+
+  template <bool kMin>
+  void PushUp(size_t index);
+
+  template <bool kMin>
+  void PushDown(size_t index);
 };
 
-bool operator<(Element a, Element b) { return a.val < b.val; }
+template <typename T>
+std::optional<T> MinMaxHeap<T>::GetMin() const {
+  if (data_.empty()) {
+    return std::nullopt;
+  }
+  return data_[0];
+}
 
 template <typename T>
-class MinHeap {
-  static constexpr size_t kCapacity = 8;
-  static constexpr size_t kTopIdx = 1;
-  const size_t kMaxQueriesCount = 1e6 + 2;
-  std::vector<T> data_;
-  std::vector<size_t> position_;
-  size_t size_;
-  int type_;  // type == 1 => minHeap, type == -1 => maxHeap
+std::optional<T> MinMaxHeap<T>::GetMax() const {
+  if (data_.empty()) {
+    return std::nullopt;
+  }
+  return data_[MaxIndex()];
+}
 
- public:
-  MinHeap()
-      : data_(kCapacity), position_(kMaxQueriesCount), size_(0), type_(1) {}
+template <typename T>
+std::optional<T> MinMaxHeap<T>::ExtractMin() {
+  if (data_.empty()) {
+    return std::nullopt;
+  }
+  return Extract(0);
+}
 
-  MinHeap(int t)
-      : data_(kCapacity), position_(kMaxQueriesCount), size_(0), type_(t) {}
+template <typename T>
+std::optional<T> MinMaxHeap<T>::ExtractMax() {
+  if (data_.empty()) {
+    return std::nullopt;
+  }
+  return Extract(MaxIndex());
+}
 
-  std::optional<T> Top() {
-    if (size_ == 0) {
-      return std::nullopt;
+template <typename T>
+void MinMaxHeap<T>::Insert(T value) {
+  data_.push_back(std::move(value));
+  size_t index = data_.size() - 1;
+  if (index == 0) {
+    return;
+  }
+  // The new leaf first settles against its parent, which decides whether it
+  // continues along the min levels or the max levels of its path.
+  size_t parent = (index - 1) / 2;
+  if (IsMinLevel(index)) {
+    if (data_[parent] < data_[index]) {
+      std::swap(data_[index], data_[parent]);
+      PushUp<false>(parent);
+    } else {
+      PushUp<true>(index);
     }
-    return data_[kTopIdx];
+  } else {
+    if (data_[index] < data_[parent]) {
+      std::swap(data_[index], data_[parent]);
+      PushUp<true>(parent);
+    } else {
+      PushUp<false>(index);
+    }
+  }
+}
+
+template <typename T>
+size_t MinMaxHeap<T>::MaxIndex() const {
+  if (data_.size() <= 2) {
+    return data_.size() - 1;
   }
+  return data_[1] < data_[2] ? 2 : 1;
+}
 
-  std::optional<T> GetMin() {
-    if (size_ == 0) {
-      return std::nullopt;
+template <typename T>
+std::optional<T> MinMaxHeap<T>::Extract(size_t index) {
+  std::optional<T> result(std::move(data_[index]));
+  if (index + 1 < data_.size()) {
+    data_[index] = std::move(data_.back());
+  }
+  data_.pop_back();
+  if (index < data_.size()) {
+    if (IsMinLevel(index)) {
+      PushDown<true>(index);
+    } else {
+      PushDown<false>(index);
     }
-    return data_[kTopIdx];
   }
+  return result;
+}
 
-  std::optional<T> ExtractMin() {
-    if (size_ == 0) {
-      return std::nullopt;
+// Moves the element up through the grandparents, i.e. along the levels of
+// its own kind, as a hole.
+template <typename T>
+template <bool kMin>
+void MinMaxHeap<T>::PushUp(size_t index) {
+  T value = std::move(data_[index]);
+  while (index >= 3) {
+    size_t grandparent = ((index - 1) / 2 - 1) / 2;
+    if (!Better<kMin>(value, data_[grandparent])) {
+      break;
     }
-    std::swap(position_[data_[kTopIdx].query_id],
-              position_[data_[size_].query_id]);
-    std::swap(data_[kTopIdx], data_[size_]);
-    --size_;
-    SiftDown(kTopIdx);
-    return data_[size_ + 1];
+    data_[index] = std::move(data_[grandparent]);
+    index = grandparent;
   }
+  data_[index] = std::move(value);
+}
 
-  void ExtractElement(size_t q_index) {
-    if (size_ > 0) {
-      size_t index = position_[q_index];
-      std::swap(position_[q_index], position_[data_[size_].query_id]);
-      std::swap(data_[index], data_[size_]);
-      --size_;
-      SiftUp(index);
-      SiftDown(index);
+// Picks the best of up to two children and four grandchildren. A grandchild
+// takes the element's place and the element moves down two levels, possibly
+// swapping with the grandchild's parent first, since that one is on a level
+// of the opposite kind; a child ends the descent.
+template <typename T>
+template <bool kMin>
+void MinMaxHeap<T>::PushDown(size_t index) {
+  size_t size = data_.size();
+  while (true) {
+    size_t first_child = 2 * index + 1;
+    if (first_child >= size) {
+      return;
+    }
+    size_t best = first_child;
+    if (first_child + 1 < size &&
+        Better<kMin>(data_[first_child + 1], data_[best])) {
+      best = first_child + 1;
+    }
+    size_t first_grandchild = 2 * first_child + 1;
+    size_t last_grandchild = std::min(first_grandchild + 4, size);
+    for (size_t grandchild = first_grandchild; grandchild < last_grandchild;
+         ++grandchild) {
+      if (Better<kMin>(data_[grandchild], data_[best])) {
+        best = grandchild;
+      }
     }
+    if (!Better<kMin>(data_[best], data_[index])) {
+      return;
+    }
+    std::swap(data_[best], data_[index]);
+    if (best < first_grandchild) {
+      return;
+    }
+    size_t parent = (best - 1) / 2;
+    if (Better<kMin>(data_[parent], data_[best])) {
+      std::swap(data_[parent], data_[best]);
+    }
+    index = best;
   }
+}
 
-  void Insert(T val) {
-    if (size_ == data_.size() - 1) {
-      data_.resize(2 * size_);
+// Radix heap for monotone keys: no key may be inserted below the last
+// minimum it extracted, last_, until it is cleared. Bucket 0 holds keys equal
+// to last_ and bucket i > 0 keys whose highest bit differing from last_ is
+// bit i - 1.
+// When bucket 0 runs out, the lowest non-empty bucket is spread over the
+// lower buckets around its minimum; keys only ever move down, so every key is
+// moved at most once per bit and all moves are sequential appends.
+template <typename Key = uint64_t>
+class RadixHeap {
+  static_assert(std::is_unsigned_v<Key>, "keys must be unsigned");
+
+ public:
+  bool CanInsert(Key key) const { return last_ <= key; }
+
+  // Requires CanInsert(key).
+  void Insert(Key key);
+
+  std::optional<Key> GetMin();
+
+  std::optional<Key> ExtractMin();
+
+  size_t Size() const { return size_; }
+
+  bool Empty() const { return size_ == 0; }
+
+  // Keeps the bucket capacity.
+  void Clear();
+
+ private:
+  static constexpr size_t kBuckets = std::numeric_limits<Key>::digits + 1;
+
+  std::array<std::vector<Key>, kBuckets> buckets_;
+  Key last_ = 0;
+  size_t size_ = 0;
+  // The smallest key outside bucket 0 once GetMin has looked for it; GetMin
+  // must not move last_, or keys between last_ and it would be refused.
+  std::optional<Key> peeked_;
+
+  size_t BucketOf(Key key) const {
+    return std::bit_width(static_cast<Key>(key ^ last_));
+  }
+
+  size_t LowestBucket() const {
+    size_t index = 1;
+    while (buckets_[index].empty()) {
+      ++index;
     }
-    data_[++size_] = val;
-    position_[val.query_id] = size_;
-    SiftUp(size_);
+    return index;
   }
 
-  size_t Size() { return size_; }
+  // Makes bucket 0 non-empty unless the heap is.
+  void Refill();
+};
 
-  bool Empty() { return size_ == 0; }
+template <typename Key>
+void RadixHeap<Key>::Insert(Key key) {
+  size_t index = BucketOf(key);
+  buckets_[index].push_back(key);
+  if (index != 0 && peeked_ && key < *peeked_) {
+    peeked_ = key;
+  }
+  ++size_;
+}
 
-  void Clear() {
-    data_.clear();
-    data_.resize(kCapacity);
-    size_ = 0;
+template <typename Key>
+std::optional<Key> RadixHeap<Key>::GetMin() {
+  if (size_ == 0) {
+    return std::nullopt;
   }
+  if (!buckets_[0].empty()) {
+    return last_;
+  }
+  if (!peeked_) {
+    const auto& bucket = buckets_[LowestBucket()];
+    peeked_ = *std::min_element(bucket.begin(), bucket.end());
+  }
+  return peeked_;
+}
 
- private:
-  void SiftUp(size_t index) {
-    if (index > kTopIdx) {
-      size_t parent = index / 2;
-      if (data_[index].val * type_ < data_[parent].val * type_) {
-        std::swap(position_[data_[index].query_id],
-                  position_[data_[parent].query_id]);
-        std::swap(data_[index], data_[parent]);
-        SiftUp(parent);
+template <typename Key>
+std::optional<Key> RadixHeap<Key>::ExtractMin() {
+  if (size_ == 0) {
+    return std::nullopt;
+  }
+  Refill();
+  buckets_[0].pop_back();
+  --size_;
+  return last_;
+}
+
+template <typename Key>
+void RadixHeap<Key>::Clear() {
+  for (auto& bucket : buckets_) {
+    bucket.clear();
+  }
+  last_ = 0;
+  size_ = 0;
+  peeked_.reset();
+}
+
+template <typename Key>
+void RadixHeap<Key>::Refill() {
+  if (!buckets_[0].empty()) {
+    return;
+  }
+  auto& bucket = buckets_[LowestBucket()];
+  last_ = peeked_ ? *peeked_ : *std::min_element(bucket.begin(), bucket.end());
+  peeked_.reset();
+  for (Key key : bucket) {
+    buckets_[BucketOf(key)].push_back(key);
+  }
+  bucket.clear();
+}
+
+// Whitespace-separated tokens of a whole input. Regular files are mapped and
+// parsed in place; pipes and terminals, which cannot be mapped, are read into
+// memory once.
+class MappedInput {
+ public:
+  explicit MappedInput(int descriptor) {
+    struct stat info;
+    if (fstat(descriptor, &info) == 0 && S_ISREG(info.st_mode) &&
+        info.st_size > 0) {
+      void* mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE,
+                           descriptor, 0);
+      if (mapping != MAP_FAILED) {
+        madvise(mapping, info.st_size, MADV_SEQUENTIAL);
+        mapping_ = mapping;
+        mapped_size_ = info.st_size;
+        begin_ = static_cast<const char*>(mapping);
+        end_ = begin_ + mapped_size_;
+        return;
       }
     }
+    static constexpr size_t kChunk = 1 << 16;
+    size_t size = 0;
+    while (true) {
+      copy_.resize(size + kChunk);
+      ssize_t count = read(descriptor, copy_.data() + size, kChunk);
+      if (count <= 0) {
+        break;
+      }
+      size += count;
+    }
+    copy_.resize(size);
+    begin_ = copy_.data();
+    end_ = begin_ + size;
   }
 
-  void SiftDown(size_t index) {
-    size_t i_min = index;
-    size_t i_left_child = index * 2;
-    size_t i_right_child = index * 2 + 1;
-    if (i_left_child <= size_ &&
-        data_[i_left_child].val * type_ < data_[i_min].val * type_) {
-      i_min = i_left_child;
+  MappedInput(const MappedInput&) = delete;
+  MappedInput& operator=(const MappedInput&) = delete;
+
+  ~MappedInput() {
+    if (mapping_ != nullptr) {
+      munmap(mapping_, mapped_size_);
     }
-    if (i_right_child <= size_ &&
-        data_[i_right_child].val * type_ < data_[i_min].val * type_) {
-      i_min = i_right_child;
+  }
+
+  // Returns an empty view at the end of the input.
+  std::string_view Word() {
+    SkipSpaces();
+    const char* start = begin_;
+    while (begin_ < end_ && static_cast<unsigned char>(*begin_) > ' ') {
+      ++begin_;
     }
-    if (index != i_min) {
-      std::swap(position_[data_[i_min].query_id],
-                position_[data_[index].query_id]);
-      std::swap(data_[i_min], data_[index]);
-      SiftDown(i_min);
+    return std::string_view(start, begin_ - start);
+  }
+
+  int64_t ReadInt() {
+    SkipSpaces();
+    bool negative = begin_ < end_ && *begin_ == '-';
+    begin_ += negative;
+    uint64_t value = 0;
+    while (begin_ < end_ && *begin_ >= '0' && *begin_ <= '9') {
+      value = value * 10 + (*begin_++ - '0');
     }
+    return static_cast<int64_t>(negative ? -value : value);
   }
+
+ private:
+  void SkipSpaces() {
+    while (begin_ < end_ && static_cast<unsigned char>(*begin_) <= ' ') {
+      ++begin_;
+    }
+  }
+
+  const char* begin_ = nullptr;
+  const char* end_ = nullptr;
+  void* mapping_ = nullptr;
+  size_t mapped_size_ = 0;
+  std::vector<char> copy_;
 };
 
-void ExtractMin(MinHeap<Element>* min_heap, MinHeap<Element>* max_heap) {
-  auto min_e = min_heap->ExtractMin();
-  if (min_e.has_value()) {
-    max_heap->ExtractElement((*min_e).query_id);
-    std::cout << (*min_e).val << '\n';
-  } else {
-    std::cout << "error" << '\n';
+// Formats replies into one reusable buffer that is written out when full.
+class OutputWriter {
+ public:
+  explicit OutputWriter(int descriptor)
+      : descriptor_(descriptor), buffer_(kBufferSize), size_(0) {}
+
+  OutputWriter(const OutputWriter&) = delete;
+  OutputWriter& operator=(const OutputWriter&) = delete;
+
+  ~OutputWriter() { Flush(); }
+
+  void WriteInt(int64_t value) {
+    Reserve(kMaxToken);
+    uint64_t magnitude = value;
+    if (value < 0) {
+      buffer_[size_++] = '-';
+      magnitude = -magnitude;
+    }
+    char digits[kMaxToken];
+    size_t count = 0;
+    do {
+      digits[count++] = '0' + magnitude % 10;
+      magnitude /= 10;
+    } while (magnitude != 0);
+    while (count > 0) {
+      buffer_[size_++] = digits[--count];
+    }
+    buffer_[size_++] = '\n';
+  }
+
+  void WriteLine(std::string_view line) {
+    Reserve(line.size() + 1);
+    std::memcpy(&buffer_[size_], line.data(), line.size());
+    size_ += line.size();
+    buffer_[size_++] = '\n';
   }
-}
 
-void GetMin(MinHeap<Element>* min_heap) {
-  auto min_e = min_heap->GetMin();
-  if (min_e.has_value()) {
-    std::cout << (*min_e).val << '\n';
+  void Flush() {
+    size_t written = 0;
+    while (written < size_) {
+      ssize_t count = write(descriptor_, &buffer_[written], size_ - written);
+      if (count <= 0) {
+        break;
+      }
+      written += count;
+    }
+    size_ = 0;
+  }
+
+ private:
+  static constexpr size_t kBufferSize = 1 << 16;
+  static constexpr size_t kMaxToken = 24;
+
+  void Reserve(size_t size) {
+    if (size_ + size > kBufferSize) {
+      Flush();
+    }
+  }
+
+  int descriptor_;
+  std::vector<char> buffer_;
+  size_t size_;
+};
+
+template <typename T>
+void WriteOrError(const std::optional<T>& value, OutputWriter& output) {
+  if (value.has_value()) {
+    output.WriteInt(*value);
   } else {
-    std::cout << "error" << '\n';
+    output.WriteLine("error");
   }
 }
 
-template <typename T>
-void ProcessCommand(std::string command, size_t idx, MinHeap<Element>* min_heap,
-                    MinHeap<Element>* max_heap) {
-  if (command == "insert") {
-    T x;
-    std::cin >> x;
-    min_heap->Insert({x, idx});
-    max_heap->Insert({x, idx});
-    std::cout << "ok" << '\n';
-  } else if (command == "get_min") {
-    GetMin(min_heap);
-  } else if (command == "extract_min") {
-    ExtractMin(min_heap, max_heap);
-  } else if (command == "get_max") {
-    GetMin(max_heap);
-  } else if (command == "extract_max") {
-    ExtractMin(max_heap, min_heap);
-  } else if (command == "size") {
-    std::cout << min_heap->Size() << '\n';
-  } else if (command == "clear") {
-    min_heap->Clear();
-    max_heap->Clear();
-    std::cout << "ok" << '\n';
-  }
-}
-
-int main() {
-  std::ios::sync_with_stdio(false);
-  std::cin.tie(nullptr);
-  std::cout.tie(nullptr);
+// Commands are told apart by the fewest bytes that differ: the first one,
+// then "get_m?x" and "extract_m?x" by the letter after the 'm'. A heap
+// without a maximum answers "error" to get_max and extract_max, and one
+// with monotone keys (CanInsert) refuses negative keys and keys below its
+// limit the same way.
+template <typename Heap>
+void ProcessCommand(std::string_view command, Heap* heap, MappedInput& input,
+                    OutputWriter& output) {
+  if (command.empty()) {
+    return;
+  }
+  constexpr bool kHasMax = requires { heap->ExtractMax(); };
+  switch (command[0]) {
+    case 'i': {
+      int64_t value = input.ReadInt();
+      if constexpr (requires { heap->CanInsert(0); }) {
+        if (value < 0 || !heap->CanInsert(value)) {
+          output.WriteLine("error");
+          break;
+        }
+      }
+      heap->Insert(value);
+      output.WriteLine("ok");
+      break;
+    }
+    case 'g':
+      if (command.size() > 5) {
+        if (command[5] == 'i') {
+          WriteOrError(heap->GetMin(), output);
+        } else if constexpr (kHasMax) {
+          WriteOrError(heap->GetMax(), output);
+        } else {
+          output.WriteLine("error");
+        }
+      }
+      break;
+    case 'e':
+      if (command.size() > 9) {
+        if (command[9] == 'i') {
+          WriteOrError(heap->ExtractMin(), output);
+        } else if constexpr (kHasMax) {
+          WriteOrError(heap->ExtractMax(), output);
+        } else {
+          output.WriteLine("error");
+        }
+      }
+      break;
+    case 's':
+      output.WriteInt(heap->Size());
+      break;
+    case 'c':
+      heap->Clear();
+      output.WriteLine("ok");
+      break;
+  }
+}
 
-  size_t q;
-  std::string command;
-  auto min_heap = new MinHeap<Element>;
-  auto max_heap = new MinHeap<Element>(-1);
-  std::cin >> q;
+template <typename Heap>
+size_t ProcessCommands(MappedInput& input, OutputWriter& output) {
+  Heap heap;
+  size_t q = input.ReadInt();
+  for (size_t i = 0; i < q; ++i) {
+    ProcessCommand(input.Word(), &heap, input, output);
+  }
+  return q;
+}
 
+// Prints a trace of q commands with non-negative keys that never go below
+// the last extracted minimum, replaying it on a RadixHeap to know that bound.
+void GenerateMonotoneTrace(size_t q) {
+  OutputWriter output(STDOUT_FILENO);
+  std::mt19937_64 generator(1);
+  RadixHeap<uint64_t> heap;
+  uint64_t minimum = 0;
+  output.WriteInt(q);
   for (size_t i = 0; i < q; ++i) {
-    std::cin >> command;
-    ProcessCommand<long long>(command, i, min_heap, max_heap);
+    uint64_t choice = generator() % 8;
+    if (heap.Empty() || choice < 4) {
+      uint64_t key = minimum + generator() % (1 << 20);
+      heap.Insert(key);
+      output.WriteLine("insert " + std::to_string(key));
+    } else if (choice == 4) {
+      heap.GetMin();
+      output.WriteLine("get_min");
+    } else {
+      minimum = *heap.ExtractMin();
+      output.WriteLine("extract_min");
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  bool stats = false;
+  bool radix = false;
+  const char* path = nullptr;
+  for (int i = 1; i < argc; ++i) {
+    if (std::strcmp(argv[i], "--stats") == 0) {
+      stats = true;
+    } else if (std::strcmp(argv[i], "--radix") == 0) {
+      radix = true;
+    } else if (std::strcmp(argv[i], "--generate") == 0 && i + 1 < argc) {
+      GenerateMonotoneTrace(std::strtoull(argv[i + 1], nullptr, 10));
+      return 0;
+    } else {
+      path = argv[i];
+    }
+  }
+  int descriptor = path == nullptr ? STDIN_FILENO : open(path, O_RDONLY);
+  if (descriptor < 0) {
+    std::perror(path);
+    return 1;
   }
 
-  delete min_heap;
-  delete max_heap;
+  auto start = std::chrono::steady_clock::now();
+  size_t q;
+  {
+    MappedInput input(descriptor);
+    OutputWriter output(STDOUT_FILENO);
+    q = radix ? ProcessCommands<RadixHeap<uint64_t>>(input, output)
+              : ProcessCommands<MinMaxHeap<long long>>(input, output);
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  if (stats) {
+    std::fprintf(stderr, "%zu commands in %.3f s: %.0f commands/s\n", q,
+                 elapsed.count(), q / elapsed.count());
+  }
+  if (path != nullptr) {
+    close(descriptor);
+  }
   return 0;
 }
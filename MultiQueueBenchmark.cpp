@@ -0,0 +1,145 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "MinHeap.cpp"
+
+// Throughput and rank error of MultiQueue against a single MinHeap behind a
+// mutex, for 1, 2, 4, ... threads up to --threads.
+
+// The baseline: the same API over one shared heap.
+template <typename T>
+class LockedHeap {
+ public:
+  void Insert(T value) {
+    std::lock_guard lock(mutex_);
+    heap_.Insert(std::move(value));
+  }
+
+  std::optional<T> ExtractMin() {
+    std::lock_guard lock(mutex_);
+    return heap_.ExtractMin();
+  }
+
+ private:
+  std::mutex mutex_;
+  MinHeap<T, 4> heap_;
+};
+
+template <typename Function>
+double RunThreads(size_t threads, Function function) {
+  std::vector<std::thread> workers;
+  auto start = std::chrono::steady_clock::now();
+  for (size_t thread = 0; thread < threads; ++thread) {
+    workers.emplace_back(function, thread);
+  }
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
+
+// Every thread alternates Insert and ExtractMin on a prefilled queue;
+// returns operations per second.
+template <typename Queue>
+double Throughput(Queue& queue, size_t threads, size_t operations) {
+  std::mt19937_64 generator(1);
+  for (size_t i = 0; i < operations; ++i) {
+    queue.Insert(generator());
+  }
+  double seconds = RunThreads(threads, [&](size_t thread) {
+    std::mt19937_64 local(thread + 2);
+    for (size_t i = 0; i < operations / threads; ++i) {
+      queue.Insert(local());
+      queue.ExtractMin();
+    }
+  });
+  return 2.0 * (operations / threads * threads) / seconds;
+}
+
+struct RankError {
+  double mean;
+  uint64_t max;
+};
+
+// The queue holds the keys 0 .. count - 1 and the threads drain it. Every
+// extraction takes a ticket, and the rank error of a key is the number of
+// smaller keys still in the queue when its ticket was taken.
+template <typename Queue>
+RankError MeasureRankError(Queue& queue, size_t threads, size_t count) {
+  std::vector<uint64_t> keys(count);
+  std::iota(keys.begin(), keys.end(), 0);
+  std::shuffle(keys.begin(), keys.end(), std::mt19937_64(3));
+  for (auto key : keys) {
+    queue.Insert(key);
+  }
+  std::vector<uint64_t> order(count);
+  std::atomic<size_t> ticket{0};
+  RunThreads(threads, [&](size_t) {
+    while (auto key = queue.ExtractMin()) {
+      order[ticket.fetch_add(1, std::memory_order_relaxed)] = *key;
+    }
+  });
+
+  // Fenwick tree over the keys still present.
+  std::vector<uint64_t> present(count + 1);
+  for (size_t i = 1; i <= count; ++i) {
+    ++present[i];
+    size_t parent = i + (i & -i);
+    if (parent <= count) {
+      present[parent] += present[i];
+    }
+  }
+  RankError error{0, 0};
+  for (auto key : order) {
+    uint64_t smaller = 0;
+    for (size_t i = key; i > 0; i -= i & -i) {
+      smaller += present[i];
+    }
+    for (size_t i = key + 1; i <= count; i += i & -i) {
+      --present[i];
+    }
+    error.mean += smaller;
+    error.max = std::max(error.max, smaller);
+  }
+  error.mean /= count;
+  return error;
+}
+
+int main(int argc, char** argv) {
+  size_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+  size_t operations = 1 << 20;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (std::strcmp(argv[i], "--threads") == 0) {
+      max_threads = std::strtoull(argv[i + 1], nullptr, 10);
+    } else if (std::strcmp(argv[i], "--operations") == 0) {
+      operations = std::strtoull(argv[i + 1], nullptr, 10);
+    }
+  }
+
+  std::printf("%8s %16s %16s %12s %10s\n", "threads", "locked ops/s",
+              "multi ops/s", "mean rank", "max rank");
+  for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+    LockedHeap<uint64_t> locked;
+    double locked_rate = Throughput(locked, threads, operations);
+    MultiQueue<uint64_t> multi(2 * threads);
+    double multi_rate = Throughput(multi, threads, operations);
+    MultiQueue<uint64_t> drained(2 * threads);
+    RankError error = MeasureRankError(drained, threads, operations);
+    std::printf("%8zu %16.0f %16.0f %12.2f %10llu\n", threads, locked_rate,
+                multi_rate, error.mean,
+                static_cast<unsigned long long>(error.max));
+  }
+  return 0;
+}
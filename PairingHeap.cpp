@@ -0,0 +1,321 @@
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <optional>
+#include <utility>
+#include <vector>
+
+// Pool of objects of one type. Memory is taken in chunks of growing size
+// and only returned when the pool is destroyed; freed slots are reused
+// first. Not thread-safe.
+template <typename T>
+class ObjectPool {
+ public:
+  ObjectPool() = default;
+
+  ObjectPool(const ObjectPool&) = delete;
+  ObjectPool& operator=(const ObjectPool&) = delete;
+
+  ~ObjectPool() {
+    for (Slot* chunk : chunks_) {
+      ::operator delete(chunk, std::align_val_t(alignof(Slot)));
+    }
+  }
+
+  template <typename... Args>
+  T* New(Args&&... args) {
+    if (free_ == nullptr) {
+      Grow();
+    }
+    Slot* slot = free_;
+    free_ = slot->next;
+    return new (slot->storage) T(std::forward<Args>(args)...);
+  }
+
+  void Delete(T* object) {
+    object->~T();
+    Slot* slot = reinterpret_cast<Slot*>(object);
+    if (free_ == nullptr) {
+      free_tail_ = slot;
+    }
+    slot->next = free_;
+    free_ = slot;
+  }
+
+  // Takes over the memory of `other` in O(chunks), together with the
+  // objects still alive in it, which must then be deleted through this pool.
+  void Absorb(ObjectPool& other) {
+    chunks_.insert(chunks_.end(), other.chunks_.begin(), other.chunks_.end());
+    other.chunks_.clear();
+    if (other.free_ != nullptr) {
+      other.free_tail_->next = free_;
+      if (free_ == nullptr) {
+        free_tail_ = other.free_tail_;
+      }
+      free_ = std::exchange(other.free_, nullptr);
+    }
+  }
+
+ private:
+  static constexpr size_t kMinChunk = 64;
+  static constexpr size_t kMaxDoublings = 10;
+
+  union Slot {
+    Slot* next;
+    alignas(T) unsigned char storage[sizeof(T)];
+  };
+
+  void Grow() {
+    size_t size =
+        kMinChunk << std::min<size_t>(chunks_.size(), kMaxDoublings);
+    Slot* chunk = static_cast<Slot*>(::operator new(
+        size * sizeof(Slot), std::align_val_t(alignof(Slot))));
+    chunks_.push_back(chunk);
+    free_tail_ = &chunk[0];
+    for (size_t i = 0; i < size; ++i) {
+      chunk[i].next = free_;
+      free_ = &chunk[i];
+    }
+  }
+
+  std::vector<Slot*> chunks_;
+  Slot* free_ = nullptr;
+  // The last free slot, valid while free_ is not null.
+  Slot* free_tail_ = nullptr;
+};
+
+// Pairing heap: a heap-ordered multiway tree kept as first-child/next-sibling
+// lists. Insert, Meld and DecreaseKey link two trees in O(1); ExtractMin
+// melds the root's children in two passes, amortized O(log n). Heaps that
+// share a pool meld by linking their roots. A heap that is the only user of
+// its own pool, as every default-constructed heap is, hands the pool's
+// chunks over first, which keeps its handles valid. Only a heap whose
+// different pool is shared with others is moved over node by node, which
+// invalidates its handles.
+template <typename T>
+class PairingHeap {
+  struct Node {
+    T key;
+    Node* child = nullptr;
+    Node* next = nullptr;
+    // The parent for a first child, otherwise the previous sibling.
+    Node* prev = nullptr;
+
+    explicit Node(T value) : key(std::move(value)) {}
+  };
+
+ public:
+  using Pool = ObjectPool<Node>;
+
+  class Handle {
+   public:
+    Handle() = default;
+
+    const T& Key() const { return node_->key; }
+
+   private:
+    friend class PairingHeap;
+
+    explicit Handle(Node* node) : node_(node) {}
+
+    Node* node_ = nullptr;
+  };
+
+  explicit PairingHeap(std::shared_ptr<Pool> pool = std::make_shared<Pool>())
+      : pool_(std::move(pool)) {}
+
+  PairingHeap(const PairingHeap&) = delete;
+  PairingHeap& operator=(const PairingHeap&) = delete;
+
+  PairingHeap(PairingHeap&& other) noexcept
+      : root_(std::exchange(other.root_, nullptr)),
+        size_(std::exchange(other.size_, 0)),
+        pool_(other.pool_) {}
+
+  PairingHeap& operator=(PairingHeap&& other) noexcept {
+    if (this != &other) {
+      Clear();
+      root_ = std::exchange(other.root_, nullptr);
+      size_ = std::exchange(other.size_, 0);
+      pool_ = other.pool_;
+    }
+    return *this;
+  }
+
+  ~PairingHeap() { Clear(); }
+
+  const std::shared_ptr<Pool>& GetPool() const { return pool_; }
+
+  Handle Insert(T key);
+
+  // Returns nullptr if the heap is empty.
+  const T* Top() const { return root_ == nullptr ? nullptr : &root_->key; }
+
+  std::optional<T> ExtractMin();
+
+  // The new key must not be greater than the current one.
+  void DecreaseKey(Handle handle, T key);
+
+  // Moves all elements of `other` here and leaves it empty.
+  void Meld(PairingHeap& other);
+
+  size_t Size() const { return size_; }
+
+  bool Empty() const { return size_ == 0; }
+
+  // Returns the nodes to the pool, which keeps their memory.
+  void Clear();
+
+ private:
+  // Both arguments are detached roots; returns the root of their union.
+  static Node* Link(Node* first, Node* second);
+
+  // Two-pass pairing of a sibling list: link neighbours left to right, then
+  // fold the results right to left into one tree.
+  static Node* MergePairs(Node* first);
+
+  // Calls visit(node) for every node in no particular order, after which
+  // the node may be deleted.
+  template <typename Visit>
+  void ForEachNode(Visit visit);
+
+  Node* root_ = nullptr;
+  size_t size_ = 0;
+  std::shared_ptr<Pool> pool_;
+};
+
+template <typename T>
+auto PairingHeap<T>::Insert(T key) -> Handle {
+  Node* node = pool_->New(std::move(key));
+  root_ = root_ == nullptr ? node : Link(root_, node);
+  ++size_;
+  return Handle(node);
+}
+
+template <typename T>
+std::optional<T> PairingHeap<T>::ExtractMin() {
+  if (root_ == nullptr) {
+    return std::nullopt;
+  }
+  std::optional<T> top(std::move(root_->key));
+  Node* children = root_->child;
+  pool_->Delete(root_);
+  root_ = children == nullptr ? nullptr : MergePairs(children);
+  --size_;
+  return top;
+}
+
+template <typename T>
+void PairingHeap<T>::DecreaseKey(Handle handle, T key) {
+  Node* node = handle.node_;
+  node->key = std::move(key);
+  if (node == root_) {
+    return;
+  }
+  if (node->prev->child == node) {
+    node->prev->child = node->next;
+  } else {
+    node->prev->next = node->next;
+  }
+  if (node->next != nullptr) {
+    node->next->prev = node->prev;
+  }
+  node->next = nullptr;
+  node->prev = nullptr;
+  root_ = Link(root_, node);
+}
+
+template <typename T>
+void PairingHeap<T>::Meld(PairingHeap& other) {
+  if (this == &other || other.root_ == nullptr) {
+    return;
+  }
+  bool shared_pool = pool_ == other.pool_;
+  if (!shared_pool && other.pool_.use_count() == 1) {
+    pool_->Absorb(*other.pool_);
+    shared_pool = true;
+  }
+  if (shared_pool) {
+    root_ = root_ == nullptr ? other.root_ : Link(root_, other.root_);
+    size_ += other.size_;
+  } else {
+    other.ForEachNode([this, &other](Node* node) {
+      Insert(std::move(node->key));
+      other.pool_->Delete(node);
+    });
+  }
+  other.root_ = nullptr;
+  other.size_ = 0;
+}
+
+template <typename T>
+void PairingHeap<T>::Clear() {
+  ForEachNode([this](Node* node) { pool_->Delete(node); });
+  root_ = nullptr;
+  size_ = 0;
+}
+
+template <typename T>
+auto PairingHeap<T>::Link(Node* first, Node* second) -> Node* {
+  if (second->key < first->key) {
+    std::swap(first, second);
+  }
+  second->next = first->child;
+  if (first->child != nullptr) {
+    first->child->prev = second;
+  }
+  second->prev = first;
+  first->child = second;
+  return first;
+}
+
+template <typename T>
+auto PairingHeap<T>::MergePairs(Node* first) -> Node* {
+  // The linked pairs are pushed on a stack threaded through `next`, so the
+  // second pass pops them right to left.
+  Node* pairs = nullptr;
+  while (first != nullptr) {
+    Node* left = first;
+    Node* right = left->next;
+    first = right == nullptr ? nullptr : right->next;
+    left->next = left->prev = nullptr;
+    if (right != nullptr) {
+      right->next = right->prev = nullptr;
+      left = Link(left, right);
+    }
+    left->next = pairs;
+    pairs = left;
+  }
+  Node* root = pairs;
+  pairs = pairs->next;
+  root->next = nullptr;
+  while (pairs != nullptr) {
+    Node* tree = pairs;
+    pairs = pairs->next;
+    tree->next = nullptr;
+    root = Link(root, tree);
+  }
+  return root;
+}
+
+template <typename T>
+template <typename Visit>
+void PairingHeap<T>::ForEachNode(Visit visit) {
+  // The children of a visited node are spliced in front of the pending
+  // list, so no recursion or extra stack is needed.
+  Node* pending = root_;
+  while (pending != nullptr) {
+    Node* node = pending;
+    pending = node->next;
+    if (node->child != nullptr) {
+      Node* last = node->child;
+      while (last->next != nullptr) {
+        last = last->next;
+      }
+      last->next = pending;
+      pending = node->child;
+    }
+    visit(node);
+  }
+}
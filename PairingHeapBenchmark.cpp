@@ -0,0 +1,102 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "MinHeap.cpp"
+#include "PairingHeap.cpp"
+
+// Scheduler-like workload: every round each worker queue receives a batch
+// of tasks, then the first queue absorbs all the others and runs part of
+// the merged work. MinHeap has to drain a queue to merge it.
+
+template <typename Function>
+double Measure(Function function) {
+  auto start = std::chrono::steady_clock::now();
+  function();
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
+
+struct Workload {
+  size_t workers;
+  size_t rounds;
+  size_t batch;
+  size_t extracted;
+};
+
+uint64_t RunPairing(const Workload& workload) {
+  auto pool = std::make_shared<PairingHeap<uint64_t>::Pool>();
+  std::vector<PairingHeap<uint64_t>> queues;
+  queues.reserve(workload.workers);
+  for (size_t worker = 0; worker < workload.workers; ++worker) {
+    queues.emplace_back(pool);
+  }
+  std::mt19937_64 generator(1);
+  uint64_t checksum = 0;
+  for (size_t round = 0; round < workload.rounds; ++round) {
+    for (auto& queue : queues) {
+      for (size_t i = 0; i < workload.batch; ++i) {
+        queue.Insert(generator());
+      }
+    }
+    for (size_t worker = 1; worker < workload.workers; ++worker) {
+      queues[0].Meld(queues[worker]);
+    }
+    for (size_t i = 0; i < workload.extracted && !queues[0].Empty(); ++i) {
+      checksum += *queues[0].ExtractMin() * (i + 1);
+    }
+  }
+  return checksum;
+}
+
+uint64_t RunMinHeap(const Workload& workload) {
+  std::vector<MinHeap<uint64_t, 4>> queues(workload.workers);
+  std::vector<uint64_t> drained;
+  std::mt19937_64 generator(1);
+  uint64_t checksum = 0;
+  for (size_t round = 0; round < workload.rounds; ++round) {
+    for (auto& queue : queues) {
+      for (size_t i = 0; i < workload.batch; ++i) {
+        queue.Insert(generator());
+      }
+    }
+    for (size_t worker = 1; worker < workload.workers; ++worker) {
+      drained.clear();
+      queues[worker].ExtractTopK(queues[worker].Size(),
+                                 std::back_inserter(drained));
+      queues[0].InsertBatch(drained.begin(), drained.end());
+    }
+    for (size_t i = 0; i < workload.extracted && !queues[0].Empty(); ++i) {
+      checksum += *queues[0].ExtractMin() * (i + 1);
+    }
+  }
+  return checksum;
+}
+
+int main(int argc, char** argv) {
+  Workload workload{16, 200, 1000, 4000};
+  if (argc > 1) {
+    workload.workers = std::max<size_t>(1, std::strtoull(argv[1], nullptr, 10));
+  }
+  if (argc > 2) {
+    workload.rounds = std::strtoull(argv[2], nullptr, 10);
+  }
+
+  uint64_t pairing_checksum = 0;
+  uint64_t heap_checksum = 0;
+  double pairing = Measure([&] { pairing_checksum = RunPairing(workload); });
+  double heap = Measure([&] { heap_checksum = RunMinHeap(workload); });
+  std::printf("%zu workers, %zu rounds of %zu inserts per worker\n",
+              workload.workers, workload.rounds, workload.batch);
+  std::printf("PairingHeap: %.3f s\nMinHeap:     %.3f s\n", pairing, heap);
+  if (pairing_checksum != heap_checksum) {
+    std::printf("results differ\n");
+    return 1;
+  }
+  return 0;
+}
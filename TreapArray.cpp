@@ -0,0 +1,1174 @@
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <random>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Aggregate policies describe what every subtree keeps about its values and
+// how that summary reacts to range updates. Unused aggregates (NoAggregate)
+// take no space in a node and compile to nothing.
+struct NoAggregate {
+  struct Type {};
+
+  template <typename T>
+  static Type Lift(const T&) {
+    return {};
+  }
+  static Type Identity() { return {}; }
+  static Type Combine(Type, Type) { return {}; }
+  template <typename T>
+  static void Add(Type&, const T&, uint32_t) {}
+  template <typename T>
+  static void Assign(Type&, const T&, uint32_t) {}
+};
+
+template <typename T>
+struct SumAggregate {
+  using Type = T;
+
+  static Type Lift(const T& value) { return value; }
+  static Type Identity() { return T(); }
+  static Type Combine(const Type& first, const Type& second) {
+    return first + second;
+  }
+  static void Add(Type& sum, const T& delta, uint32_t size) {
+    sum += delta * static_cast<T>(size);
+  }
+  static void Assign(Type& sum, const T& value, uint32_t size) {
+    sum = value * static_cast<T>(size);
+  }
+};
+
+template <typename T>
+struct MinAggregate {
+  using Type = T;
+
+  static Type Lift(const T& value) { return value; }
+  static Type Identity() { return std::numeric_limits<T>::max(); }
+  static Type Combine(const Type& first, const Type& second) {
+    return std::min(first, second);
+  }
+  static void Add(Type& min, const T& delta, uint32_t) { min += delta; }
+  static void Assign(Type& min, const T& value, uint32_t) { min = value; }
+};
+
+template <typename T>
+struct MaxAggregate {
+  using Type = T;
+
+  static Type Lift(const T& value) { return value; }
+  static Type Identity() { return std::numeric_limits<T>::lowest(); }
+  static Type Combine(const Type& first, const Type& second) {
+    return std::max(first, second);
+  }
+  static void Add(Type& max, const T& delta, uint32_t) { max += delta; }
+  static void Assign(Type& max, const T& value, uint32_t) { max = value; }
+};
+
+// Lazy-tag policies describe a range update: how it changes a value and an
+// aggregate, and how a newer tag is composed on top of a pending one.
+struct NoTag {
+  struct Type {};
+  static constexpr bool kReverses = false;
+
+  static bool Empty(Type) { return true; }
+  static void Compose(Type&, Type) {}
+  template <typename T>
+  static void ApplyValue(T&, Type) {}
+  template <typename Aggregate>
+  static void ApplyAggregate(typename Aggregate::Type&, Type, uint32_t) {}
+};
+
+template <typename T>
+struct AddTag {
+  using Type = T;
+  static constexpr bool kReverses = false;
+
+  static bool Empty(const Type& tag) { return tag == T(); }
+  static void Compose(Type& pending, const Type& tag) { pending += tag; }
+  static void ApplyValue(T& value, const Type& tag) { value += tag; }
+  template <typename Aggregate>
+  static void ApplyAggregate(typename Aggregate::Type& aggregate,
+                             const Type& tag, uint32_t size) {
+    Aggregate::Add(aggregate, tag, size);
+  }
+};
+
+template <typename T>
+struct AssignTag {
+  using Type = std::optional<T>;
+  static constexpr bool kReverses = false;
+
+  static bool Empty(const Type& tag) { return !tag.has_value(); }
+  static void Compose(Type& pending, const Type& tag) {
+    if (tag.has_value()) {
+      pending = tag;
+    }
+  }
+  static void ApplyValue(T& value, const Type& tag) { value = *tag; }
+  template <typename Aggregate>
+  static void ApplyAggregate(typename Aggregate::Type& aggregate,
+                             const Type& tag, uint32_t size) {
+    Aggregate::Assign(aggregate, *tag, size);
+  }
+};
+
+// Reversal only reorders values, so it leaves values and (commutative)
+// aggregates untouched; the treap swaps children when the tag is applied.
+struct ReverseTag {
+  using Type = bool;
+  static constexpr bool kReverses = true;
+
+  static bool Empty(Type tag) { return !tag; }
+  static bool Reverses(Type tag) { return tag; }
+  static void Compose(Type& pending, Type tag) { pending ^= tag; }
+  template <typename T>
+  static void ApplyValue(T&, Type) {}
+  template <typename Aggregate>
+  static void ApplyAggregate(typename Aggregate::Type&, Type, uint32_t) {}
+};
+
+inline size_t DefaultThreads() {
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// A different priority seed for every treap, so that treaps built apart and
+// later concatenated do not repeat one another's priority sequence.
+inline uint32_t NextTreapSeed() {
+  static std::atomic<uint32_t> next_seed{0};
+  return next_seed.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Number of fork levels that gives every one of `threads` threads a task.
+inline int SpawnDepth(size_t threads) {
+  int depth = 0;
+  while ((size_t{1} << depth) < threads) {
+    ++depth;
+  }
+  return depth;
+}
+
+// Runs both tasks and waits for them, the first one on its own thread while
+// the fork budget `depth` is positive.
+template <typename First, typename Second>
+void ForkJoin(int depth, First first, Second second) {
+  if (depth <= 0) {
+    first();
+    second();
+    return;
+  }
+  auto forked = std::async(std::launch::async, first);
+  second();
+  forked.get();
+}
+
+template <typename Function>
+void ParallelFor(size_t begin, size_t end, int depth, const Function& fn) {
+  if (end - begin <= 1 || depth <= 0) {
+    for (size_t i = begin; i < end; ++i) {
+      fn(i);
+    }
+    return;
+  }
+  size_t middle = begin + (end - begin) / 2;
+  ForkJoin(
+      depth, [&] { ParallelFor(begin, middle, depth - 1, fn); },
+      [&] { ParallelFor(middle, end, depth - 1, fn); });
+}
+
+// Node layout shared by the treaps; Link is an arena index or a pointer.
+template <typename T, typename Aggregate, typename Tag, typename Link>
+struct TreapNode {
+  TreapNode(uint32_t priority, const T& value)
+      : size(1),
+        priority(priority),
+        left(),
+        right(),
+        value(value),
+        aggregate(Aggregate::Lift(value)),
+        pending() {}
+
+  uint32_t size;
+  uint32_t priority;
+  Link left;
+  Link right;
+  T value;
+  [[no_unique_address]] typename Aggregate::Type aggregate;
+  // Already applied to this node, still to be applied to its children.
+  [[no_unique_address]] typename Tag::Type pending;
+};
+
+// Read-only walks shared by the treaps. Derived resolves a link to its node
+// with Get(link), and a value-initialized Link is the null link. The pending
+// tags of the ancestors are composed on the way down and applied to what is
+// read instead of being pushed, so a walk writes nothing.
+template <typename Derived, typename T, typename Aggregate, typename Tag,
+          typename Link>
+class TreapReader {
+ protected:
+  using AggregateType = typename Aggregate::Type;
+  using TagType = typename Tag::Type;
+
+  static constexpr Link kNull = Link();
+
+  // Walks the two boundary paths of [from, to] and combines the O(log n)
+  // subtree aggregates between them.
+  AggregateType QueryRange(Link node, int64_t from, int64_t to) const {
+    TagType tag = TagType();
+    while (true) {
+      auto [first, second] = Children(node, tag);
+      int64_t left_size = Size(first);
+      if (to < left_size) {
+        tag = ChildTag(node, tag);
+        node = first;
+      } else if (from > left_size) {
+        tag = ChildTag(node, tag);
+        from -= left_size + 1;
+        to -= left_size + 1;
+        node = second;
+      } else {
+        break;
+      }
+    }
+    AggregateType result = Aggregate::Lift(ValueOf(node, tag));
+    auto [split_first, split_second] = Children(node, tag);
+    to -= Size(split_first) + 1;
+    TagType split_tag = ChildTag(node, tag);
+
+    // Suffix of the left part, collected right to left.
+    tag = split_tag;
+    for (node = split_first; node != kNull;) {
+      auto [first, second] = Children(node, tag);
+      int64_t left_size = Size(first);
+      TagType child_tag = ChildTag(node, tag);
+      if (from <= left_size) {
+        result = Aggregate::Combine(
+            Aggregate::Combine(Aggregate::Lift(ValueOf(node, tag)),
+                               AggregateOf(second, child_tag)),
+            result);
+        node = first;
+      } else {
+        from -= left_size + 1;
+        node = second;
+      }
+      tag = std::move(child_tag);
+    }
+
+    // Prefix of the right part, collected left to right.
+    tag = split_tag;
+    for (node = split_second; node != kNull && to >= 0;) {
+      auto [first, second] = Children(node, tag);
+      int64_t left_size = Size(first);
+      TagType child_tag = ChildTag(node, tag);
+      if (to >= left_size) {
+        result = Aggregate::Combine(
+            result, Aggregate::Combine(AggregateOf(first, child_tag),
+                                       Aggregate::Lift(ValueOf(node, tag))));
+        to -= left_size + 1;
+        node = second;
+      } else {
+        node = first;
+      }
+      tag = std::move(child_tag);
+    }
+    return result;
+  }
+
+  T ValueAt(Link node, int64_t pos) const {
+    TagType tag = TagType();
+    while (true) {
+      auto [first, second] = Children(node, tag);
+      int64_t left_size = Size(first);
+      if (pos == left_size) {
+        return ValueOf(node, tag);
+      }
+      tag = ChildTag(node, tag);
+      if (pos < left_size) {
+        node = first;
+      } else {
+        pos -= left_size + 1;
+        node = second;
+      }
+    }
+  }
+
+  int64_t Size(Link node) const {
+    if (node == kNull) {
+      return 0;
+    }
+    return NodeOf(node).size;
+  }
+
+  AggregateType AggregateOf(Link node) const {
+    if (node == kNull) {
+      return Aggregate::Identity();
+    }
+    return NodeOf(node).aggregate;
+  }
+
+  // `tag` is the composition of the ancestors' pending tags that the node
+  // has not seen yet.
+  AggregateType AggregateOf(Link node, const TagType& tag) const {
+    AggregateType aggregate = AggregateOf(node);
+    if (node != kNull && !Tag::Empty(tag)) {
+      Tag::template ApplyAggregate<Aggregate>(aggregate, tag,
+                                              NodeOf(node).size);
+    }
+    return aggregate;
+  }
+
+  T ValueOf(Link node, const TagType& tag) const {
+    T value = NodeOf(node).value;
+    if (!Tag::Empty(tag)) {
+      Tag::ApplyValue(value, tag);
+    }
+    return value;
+  }
+
+  TagType ChildTag(Link node, const TagType& tag) const {
+    TagType child_tag = NodeOf(node).pending;
+    Tag::Compose(child_tag, tag);
+    return child_tag;
+  }
+
+  std::pair<Link, Link> Children(Link node, const TagType& tag) const {
+    const auto& n = NodeOf(node);
+    if constexpr (Tag::kReverses) {
+      if (Tag::Reverses(tag)) {
+        return {n.right, n.left};
+      }
+    }
+    return {n.left, n.right};
+  }
+
+  const auto& NodeOf(Link node) const {
+    return static_cast<const Derived&>(*this).Get(node);
+  }
+};
+
+// Split, Merge and tag propagation shared by the treaps. Derived also
+// provides Own(link), the link of a node the writer may modify: the node
+// itself unless another version of a persistent treap can still see it,
+// in which case a private copy. Every node on a modified path is owned
+// before it is changed.
+template <typename Derived, typename T, typename Aggregate, typename Tag,
+          typename Link>
+class TreapWriter : public TreapReader<Derived, T, Aggregate, Tag, Link> {
+ protected:
+  using Reader = TreapReader<Derived, T, Aggregate, Tag, Link>;
+  using typename Reader::TagType;
+  using Reader::AggregateOf;
+  using Reader::kNull;
+  using Reader::NodeOf;
+  using Reader::Size;
+
+  // Split and Merge run top-down: nodes are pushed on the way down and
+  // linked through `hole`, the child slot still waiting for a subtree; the
+  // touched nodes are then updated bottom-up from the recorded path. Both
+  // take over the trees they are given.
+  Link Merge(Link first, Link second) {
+    Link root = kNull;
+    Link* hole = &root;
+    path_.clear();
+    while (first != kNull && second != kNull) {
+      if (NodeOf(first).priority > NodeOf(second).priority) {
+        first = Self().Own(first);
+        Push(first);
+        *hole = first;
+        path_.push_back(first);
+        hole = &NodeOf(first).right;
+        first = *hole;
+      } else {
+        second = Self().Own(second);
+        Push(second);
+        *hole = second;
+        path_.push_back(second);
+        hole = &NodeOf(second).left;
+        second = *hole;
+      }
+    }
+    *hole = first != kNull ? first : second;
+    UpdatePath();
+    return root;
+  }
+
+  std::pair<Link, Link> Split(Link node, int64_t pos) {
+    Link left = kNull;
+    Link right = kNull;
+    Link* left_hole = &left;
+    Link* right_hole = &right;
+    path_.clear();
+    while (node != kNull) {
+      node = Self().Own(node);
+      Push(node);
+      path_.push_back(node);
+      auto& n = NodeOf(node);
+      int64_t left_size = Size(n.left);
+      if (pos <= left_size) {
+        *right_hole = node;
+        right_hole = &n.left;
+        node = n.left;
+      } else {
+        *left_hole = node;
+        left_hole = &n.right;
+        pos -= left_size + 1;
+        node = n.right;
+      }
+    }
+    *left_hole = kNull;
+    *right_hole = kNull;
+    UpdatePath();
+    return {left, right};
+  }
+
+  // Applies `tag` to positions [left, right] and returns the new root.
+  Link ApplyRange(Link root, size_t left, size_t right, const TagType& tag) {
+    auto [first, second_with_range] = Split(root, left);
+    auto [range, second] = Split(second_with_range, right + 1 - left);
+    range = Self().Own(range);
+    ApplyTag(range, tag);
+    return Merge(first, Merge(range, second));
+  }
+
+  // Expects the pending tag of the node to be pushed already.
+  void Update(Link node) {
+    auto& n = NodeOf(node);
+    n.size = 1 + Size(n.left) + Size(n.right);
+    n.aggregate = Aggregate::Combine(
+        Aggregate::Combine(AggregateOf(n.left), Aggregate::Lift(n.value)),
+        AggregateOf(n.right));
+  }
+
+  // The node must be owned.
+  void ApplyTag(Link node, const TagType& tag) {
+    if (node == kNull) {
+      return;
+    }
+    auto& n = NodeOf(node);
+    Tag::ApplyValue(n.value, tag);
+    Tag::template ApplyAggregate<Aggregate>(n.aggregate, tag, n.size);
+    Tag::Compose(n.pending, tag);
+    if constexpr (Tag::kReverses) {
+      if (Tag::Reverses(tag)) {
+        std::swap(n.left, n.right);
+      }
+    }
+  }
+
+  // The node must be owned; its children are owned before they change.
+  void Push(Link node) {
+    if (node == kNull || Tag::Empty(NodeOf(node).pending)) {
+      return;
+    }
+    auto& n = NodeOf(node);
+    n.left = Self().Own(n.left);
+    ApplyTag(n.left, n.pending);
+    n.right = Self().Own(n.right);
+    ApplyTag(n.right, n.pending);
+    n.pending = TagType();
+  }
+
+  // Linear-time construction from nodes appended in order: a stack keeps
+  // the right spine, and a node's subtree is complete once it is popped,
+  // so aggregates are computed bottom-up at that moment.
+  void AppendToSpine(std::vector<Link>& spine, Link node) {
+    Link last_popped = kNull;
+    while (!spine.empty() &&
+           NodeOf(spine.back()).priority < NodeOf(node).priority) {
+      last_popped = spine.back();
+      spine.pop_back();
+      Update(last_popped);
+    }
+    NodeOf(node).left = last_popped;
+    if (!spine.empty()) {
+      NodeOf(spine.back()).right = node;
+    }
+    spine.push_back(node);
+  }
+
+  Link CloseSpine(const std::vector<Link>& spine) {
+    if (spine.empty()) {
+      return kNull;
+    }
+    for (auto it = spine.rbegin(); it != spine.rend(); ++it) {
+      Update(*it);
+    }
+    return spine.front();
+  }
+
+  auto& NodeOf(Link node) { return Self().Get(node); }
+
+  std::mt19937 gen_{NextTreapSeed()};
+
+ private:
+  Derived& Self() { return static_cast<Derived&>(*this); }
+
+  void UpdatePath() {
+    for (auto it = path_.rbegin(); it != path_.rend(); ++it) {
+      Update(*it);
+    }
+  }
+
+  std::vector<Link> path_;
+};
+
+template <typename T, typename Aggregate = MinAggregate<T>,
+          typename Tag = AddTag<T>>
+class TreapArray : public TreapWriter<TreapArray<T, Aggregate, Tag>, T,
+                                      Aggregate, Tag, uint32_t> {
+  using Writer = TreapWriter<TreapArray, T, Aggregate, Tag, uint32_t>;
+  using typename Writer::AggregateType;
+  using typename Writer::Reader;
+  using typename Writer::TagType;
+  using Writer::AppendToSpine;
+  using Writer::ApplyTag;
+  using Writer::ChildTag;
+  using Writer::Children;
+  using Writer::CloseSpine;
+  using Writer::gen_;
+  using Writer::kNull;
+  using Writer::Merge;
+  using Writer::Push;
+  using Writer::Size;
+  using Writer::Split;
+  using Writer::Update;
+  using Writer::ValueOf;
+  friend Reader;
+  friend Writer;
+
+  // Nodes live in one contiguous arena and refer to each other by 32-bit
+  // indices; slot kNull is a never-used sentinel, erased slots are chained
+  // into a free list through their `left` field.
+  using Node = TreapNode<T, Aggregate, Tag, uint32_t>;
+
+  // Subtrees smaller than this are never split between threads.
+  static constexpr uint32_t kParallelGrain = 1 << 14;
+
+ public:
+  TreapArray() : nodes_(1, Node(0, T())), root_(kNull), free_head_(kNull) {}
+
+  TreapArray(const std::vector<T>& array)
+      : TreapArray(array.begin(), array.end()) {}
+
+  template <typename InputIt>
+  TreapArray(InputIt first, InputIt last) : TreapArray() {
+    root_ = Build(first, last);
+  }
+
+  int64_t Size() { return Size(root_); }
+
+  bool Empty() { return Size(root_) == 0; }
+
+  void Reserve(size_t count) { nodes_.reserve(count + 1); }
+
+  void Clear() {
+    nodes_.resize(1, Node(0, T()));
+    root_ = kNull;
+    free_head_ = kNull;
+  }
+
+  size_t MemoryUsage() const {
+    return sizeof(*this) + nodes_.capacity() * sizeof(Node);
+  }
+
+  void Erase(int64_t pos) {
+    auto [left, right_with_pos] = Split(root_, pos);
+    auto [pos_tree, right] = Split(right_with_pos, 1);
+    Free(pos_tree);
+    root_ = Merge(left, right);
+  }
+
+  void Insert(int64_t pos, const T& value) {
+    uint32_t node = Allocate(gen_(), value);
+    auto [first, second] = Split(root_, pos);
+    root_ = Merge(Merge(first, node), second);
+  }
+
+  template <typename InputIt>
+  void InsertRange(int64_t pos, InputIt first, InputIt last) {
+    uint32_t range = Build(first, last);
+    auto [left, right] = Split(root_, pos);
+    root_ = Merge(Merge(left, range), right);
+  }
+
+  // Read-only: pending tags are composed along the boundary paths and
+  // applied to the pieces instead of being pushed down.
+  AggregateType Query(size_t left, size_t right) const {
+    return this->QueryRange(root_, left, right);
+  }
+
+  void Apply(size_t left, size_t right, const TagType& tag) {
+    root_ = this->ApplyRange(root_, left, right, tag);
+  }
+
+  T GetMin(size_t left, size_t right)
+    requires std::is_same_v<Aggregate, MinAggregate<T>>
+  {
+    return Query(left, right);
+  }
+
+  void Add(size_t left, size_t right, T increment)
+    requires std::is_same_v<Tag, AddTag<T>>
+  {
+    Apply(left, right, increment);
+  }
+
+  void Assign(size_t left, size_t right, const T& value)
+    requires std::is_same_v<Tag, AssignTag<T>>
+  {
+    Apply(left, right, value);
+  }
+
+  void Reverse(size_t left, size_t right)
+    requires std::is_same_v<Tag, ReverseTag>
+  {
+    Apply(left, right, true);
+  }
+
+  T at(int64_t pos) { return nodes_[Find(pos)].value; }
+
+  // The reference is invalidated by the next Insert, which may grow the arena.
+  T& operator[](int64_t pos) { return nodes_[Find(pos)].value; }
+
+  // In-order iterator that pushes pending tags down as it descends. It keeps
+  // the path to the current node on an explicit stack and is invalidated by
+  // any modification of the array.
+  class Iterator {
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = T;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const T*;
+    using reference = const T&;
+
+    Iterator() : treap_(nullptr) {}
+
+    const T& operator*() const { return treap_->nodes_[path_.back()].value; }
+
+    const T* operator->() const { return &**this; }
+
+    Iterator& operator++() {
+      uint32_t node = path_.back();
+      path_.pop_back();
+      DescendLeft(treap_->nodes_[node].right);
+      return *this;
+    }
+
+    Iterator operator++(int) {
+      Iterator copy = *this;
+      ++*this;
+      return copy;
+    }
+
+    bool operator==(const Iterator& other) const {
+      return (path_.empty() ? kNull : path_.back()) ==
+             (other.path_.empty() ? kNull : other.path_.back());
+    }
+
+    bool operator!=(const Iterator& other) const { return !(*this == other); }
+
+   private:
+    friend class TreapArray;
+
+    explicit Iterator(TreapArray* treap) : treap_(treap) {}
+
+    // Positions the iterator at `pos` keeping on the path only the nodes
+    // whose value is still to be visited.
+    void Seek(uint32_t node, int64_t pos) {
+      while (node != kNull) {
+        treap_->Push(node);
+        int64_t left_size = treap_->Size(treap_->nodes_[node].left);
+        if (pos < left_size) {
+          path_.push_back(node);
+          node = treap_->nodes_[node].left;
+        } else if (pos == left_size) {
+          path_.push_back(node);
+          return;
+        } else {
+          pos -= left_size + 1;
+          node = treap_->nodes_[node].right;
+        }
+      }
+    }
+
+    void DescendLeft(uint32_t node) {
+      for (; node != kNull; node = treap_->nodes_[node].left) {
+        treap_->Push(node);
+        path_.push_back(node);
+      }
+    }
+
+    TreapArray* treap_;
+    std::vector<uint32_t> path_;
+  };
+
+  Iterator begin() { return IteratorAt(0); }
+
+  Iterator end() { return Iterator(this); }
+
+  Iterator IteratorAt(int64_t pos) {
+    Iterator it(this);
+    it.Seek(root_, pos);
+    return it;
+  }
+
+  // Calls fn(value) for positions left..right inclusive in O(k + log n).
+  template <typename Function>
+  void ForEachRange(int64_t left, int64_t right, Function fn) {
+    auto it = IteratorAt(left);
+    for (int64_t i = left; i <= right; ++i, ++it) {
+      fn(*it);
+    }
+  }
+
+  // Bulk operations below fork the work over up to `threads` threads; the
+  // parallel tasks touch disjoint subtrees or disjoint arena slots.
+  template <typename RandomIt>
+  static TreapArray ParallelBuild(RandomIt first, RandomIt last,
+                                  size_t threads = DefaultThreads()) {
+    TreapArray result;
+    size_t count = last - first;
+    size_t chunks =
+        std::min(std::max<size_t>(1, threads), count / kParallelGrain + 1);
+    result.nodes_.resize(count + 1, Node(0, T()));
+    std::vector<uint32_t> roots(chunks, kNull);
+    std::vector<uint32_t> seeds(chunks);
+    for (auto& seed : seeds) {
+      seed = result.gen_();
+    }
+    ParallelFor(0, chunks, SpawnDepth(threads), [&](size_t chunk) {
+      std::mt19937 gen(seeds[chunk]);
+      std::vector<uint32_t> spine;
+      for (size_t i = count * chunk / chunks;
+           i < count * (chunk + 1) / chunks; ++i) {
+        result.nodes_[i + 1] = Node(gen(), first[i]);
+        result.AppendToSpine(spine, i + 1);
+      }
+      roots[chunk] = result.CloseSpine(spine);
+    });
+    for (uint32_t root : roots) {
+      result.root_ = result.Merge(result.root_, root);
+    }
+    return result;
+  }
+
+  // Concatenates the arrays in order; the arenas are copied side by side
+  // in parallel with their indices shifted, then the roots are merged.
+  static TreapArray Concat(std::vector<TreapArray>&& parts,
+                           size_t threads = DefaultThreads()) {
+    TreapArray result;
+    std::vector<uint32_t> offsets(parts.size() + 1, 0);
+    for (size_t i = 0; i < parts.size(); ++i) {
+      offsets[i + 1] = offsets[i] + parts[i].nodes_.size() - 1;
+    }
+    result.nodes_.resize(offsets.back() + 1, Node(0, T()));
+    std::vector<uint32_t> roots(parts.size());
+    std::vector<uint32_t> free_heads(parts.size());
+    std::vector<uint32_t> free_tails(parts.size(), kNull);
+    ParallelFor(0, parts.size(), SpawnDepth(threads), [&](size_t part) {
+      uint32_t offset = offsets[part];
+      auto shift = [offset](uint32_t node) {
+        return node == kNull ? kNull : node + offset;
+      };
+      std::vector<Node>& nodes = parts[part].nodes_;
+      for (uint32_t node = 1; node < nodes.size(); ++node) {
+        Node& copy = result.nodes_[shift(node)];
+        copy = nodes[node];
+        copy.left = shift(copy.left);
+        copy.right = shift(copy.right);
+      }
+      for (uint32_t node = parts[part].free_head_; node != kNull;
+           node = nodes[node].left) {
+        free_tails[part] = shift(node);
+      }
+      roots[part] = shift(parts[part].root_);
+      free_heads[part] = shift(parts[part].free_head_);
+      parts[part].Clear();
+      nodes.shrink_to_fit();
+    });
+    uint32_t free_tail = kNull;
+    for (size_t part = 0; part < parts.size(); ++part) {
+      result.root_ = result.Merge(result.root_, roots[part]);
+      if (free_heads[part] == kNull) {
+        continue;
+      }
+      if (free_tail == kNull) {
+        result.free_head_ = free_heads[part];
+      } else {
+        result.nodes_[free_tail].left = free_heads[part];
+      }
+      free_tail = free_tails[part];
+    }
+    return result;
+  }
+
+  // Calls fn(value) for every value in [left, right]; fn runs concurrently
+  // on different elements, and aggregates are recomputed afterwards.
+  template <typename Function>
+  void ParallelApply(size_t left, size_t right, Function fn,
+                     size_t threads = DefaultThreads()) {
+    auto [first, second_with_range] = Split(root_, left);
+    auto [range, second] = Split(second_with_range, right + 1 - left);
+    ApplyToSubtree(range, fn, SpawnDepth(threads));
+    root_ = Merge(first, Merge(range, second));
+  }
+
+  // Folds map(value) over [left, right] with an associative `combine`.
+  template <typename R, typename Map, typename Combine>
+  R ParallelReduce(size_t left, size_t right, const R& identity, Map map,
+                   Combine combine, size_t threads = DefaultThreads()) {
+    auto [first, second_with_range] = Split(root_, left);
+    auto [range, second] = Split(second_with_range, right + 1 - left);
+    R result = ReduceSubtree(range, TagType(), identity, map, combine,
+                             SpawnDepth(threads));
+    root_ = Merge(first, Merge(range, second));
+    return result;
+  }
+
+  std::vector<T> ToVector() {
+    std::vector<T> result;
+    result.reserve(Size());
+    for (const T& value : *this) {
+      result.push_back(value);
+    }
+    return result;
+  }
+
+  void Print() {
+    for (const T& value : *this) {
+      std::cout << value << ' ';
+    }
+  }
+
+ private:
+  Node& Get(uint32_t node) { return nodes_[node]; }
+
+  const Node& Get(uint32_t node) const { return nodes_[node]; }
+
+  // Arena nodes are never shared.
+  uint32_t Own(uint32_t node) { return node; }
+
+  uint32_t Allocate(uint32_t priority, const T& value) {
+    if (free_head_ == kNull) {
+      nodes_.emplace_back(priority, value);
+      return static_cast<uint32_t>(nodes_.size() - 1);
+    }
+    uint32_t node = free_head_;
+    free_head_ = nodes_[node].left;
+    nodes_[node] = Node(priority, value);
+    return node;
+  }
+
+  void Free(uint32_t node) {
+    if (node == kNull) {
+      return;
+    }
+    nodes_[node].left = free_head_;
+    free_head_ = node;
+  }
+
+  // Builds a treap over [first, last) in O(n).
+  template <typename InputIt>
+  uint32_t Build(InputIt first, InputIt last) {
+    using Category = typename std::iterator_traits<InputIt>::iterator_category;
+    if constexpr (std::is_base_of_v<std::forward_iterator_tag, Category>) {
+      nodes_.reserve(nodes_.size() + std::distance(first, last));
+    }
+    std::vector<uint32_t> spine;
+    for (; first != last; ++first) {
+      AppendToSpine(spine, Allocate(gen_(), *first));
+    }
+    return CloseSpine(spine);
+  }
+
+  template <typename Function>
+  void ApplyToSubtree(uint32_t node, Function& fn, int depth) {
+    if (node == kNull) {
+      return;
+    }
+    Push(node);
+    Node& n = nodes_[node];
+    if (n.size < kParallelGrain) {
+      depth = 0;
+    }
+    ForkJoin(
+        depth, [&] { ApplyToSubtree(n.left, fn, depth - 1); },
+        [&] { ApplyToSubtree(n.right, fn, depth - 1); });
+    fn(n.value);
+    Update(node);
+  }
+
+  template <typename R, typename Map, typename Combine>
+  R ReduceSubtree(uint32_t node, const TagType& tag, const R& identity,
+                  Map& map, Combine& combine, int depth) const {
+    if (node == kNull) {
+      return identity;
+    }
+    if (nodes_[node].size < kParallelGrain) {
+      depth = 0;
+    }
+    auto [first, second] = Children(node, tag);
+    TagType child_tag = ChildTag(node, tag);
+    R left = identity;
+    R right = identity;
+    ForkJoin(
+        depth,
+        [&] {
+          left = ReduceSubtree(first, child_tag, identity, map, combine,
+                               depth - 1);
+        },
+        [&] {
+          right = ReduceSubtree(second, child_tag, identity, map, combine,
+                                depth - 1);
+        });
+    return combine(combine(left, map(ValueOf(node, tag))), right);
+  }
+
+  uint32_t Find(int64_t pos) {
+    uint32_t node = root_;
+    while (node != kNull) {
+      Push(node);
+      int64_t left_size = Size(nodes_[node].left);
+      if (pos == left_size) {
+        break;
+      }
+      if (pos < left_size) {
+        node = nodes_[node].left;
+      } else {
+        pos -= left_size + 1;
+        node = nodes_[node].right;
+      }
+    }
+    return node;
+  }
+
+  std::vector<Node> nodes_;
+  uint32_t root_;
+  uint32_t free_head_;
+};
+
+// Node of PersistentTreapArray: the shared layout plus a reference count.
+template <typename T, typename Aggregate, typename Tag>
+struct SharedTreapNode
+    : TreapNode<T, Aggregate, Tag, SharedTreapNode<T, Aggregate, Tag>*> {
+  using Base = TreapNode<T, Aggregate, Tag, SharedTreapNode*>;
+  using Base::Base;
+
+  // A copy starts out referenced only by the writer that made it.
+  SharedTreapNode(const SharedTreapNode& other) : Base(other) {}
+
+  // Counts parents, versions and the writer's in-flight references.
+  std::atomic<uint32_t> refs{1};
+};
+
+// Persistent variant of TreapArray: edits copy the root-to-node paths they
+// touch, so every published version stays immutable and can be queried from
+// any number of threads without locks while a single writer keeps editing.
+// Nodes are shared between versions and reclaimed by reference counting;
+// they are heap-allocated rather than taken from an arena because the last
+// reference to a node may be dropped by any thread.
+template <typename T, typename Aggregate = MinAggregate<T>,
+          typename Tag = AddTag<T>>
+class PersistentTreapArray
+    : public TreapWriter<PersistentTreapArray<T, Aggregate, Tag>, T,
+                         Aggregate, Tag, SharedTreapNode<T, Aggregate, Tag>*> {
+  using Node = SharedTreapNode<T, Aggregate, Tag>;
+  using Writer = TreapWriter<PersistentTreapArray, T, Aggregate, Tag, Node*>;
+  using typename Writer::AggregateType;
+  using typename Writer::Reader;
+  using typename Writer::TagType;
+  using Writer::AppendToSpine;
+  using Writer::CloseSpine;
+  using Writer::gen_;
+  using Writer::Merge;
+  using Writer::Size;
+  using Writer::Split;
+  friend Reader;
+  friend Writer;
+
+  struct Version {
+    explicit Version(Node* root) : root(root) {}
+    ~Version() { Release(root); }
+
+    Node* root;
+  };
+
+ public:
+  // Read-only handle to one version of the array. Queries never write to
+  // shared memory, so handles can be used concurrently from any thread.
+  class View : public TreapReader<View, T, Aggregate, Tag, Node*> {
+    using Reader = TreapReader<View, T, Aggregate, Tag, Node*>;
+    friend Reader;
+
+   public:
+    View() = default;
+
+    int64_t Size() const { return Reader::Size(Root()); }
+
+    bool Empty() const { return Size() == 0; }
+
+    AggregateType Query(size_t left, size_t right) const {
+      return this->QueryRange(Root(), left, right);
+    }
+
+    T GetMin(size_t left, size_t right) const
+      requires std::is_same_v<Aggregate, MinAggregate<T>>
+    {
+      return Query(left, right);
+    }
+
+    T at(int64_t pos) const { return this->ValueAt(Root(), pos); }
+
+   private:
+    friend class PersistentTreapArray;
+
+    explicit View(std::shared_ptr<const Version> version)
+        : version_(std::move(version)) {}
+
+    static Node& Get(Node* node) { return *node; }
+
+    Node* Root() const {
+      return version_ == nullptr ? nullptr : version_->root;
+    }
+
+    std::shared_ptr<const Version> version_;
+  };
+
+  PersistentTreapArray() : root_(nullptr) { Publish(); }
+
+  PersistentTreapArray(const std::vector<T>& array) : root_(nullptr) {
+    root_ = Build(array.begin(), array.end());
+    Publish();
+  }
+
+  PersistentTreapArray(const PersistentTreapArray&) = delete;
+  PersistentTreapArray& operator=(const PersistentTreapArray&) = delete;
+
+  ~PersistentTreapArray() { Release(root_); }
+
+  // Safe to call from any thread; returns the latest published version.
+  View Snapshot() const { return View(std::atomic_load(&published_)); }
+
+  int64_t Size() const { return Size(root_); }
+
+  bool Empty() const { return Size() == 0; }
+
+  void Insert(int64_t pos, const T& value) {
+    auto [first, second] = Split(root_, pos);
+    root_ = Merge(Merge(first, new Node(gen_(), value)), second);
+    Publish();
+  }
+
+  void Erase(int64_t pos) {
+    auto [left, right_with_pos] = Split(root_, pos);
+    auto [pos_tree, right] = Split(right_with_pos, 1);
+    Release(pos_tree);
+    root_ = Merge(left, right);
+    Publish();
+  }
+
+  AggregateType Query(size_t left, size_t right) const {
+    return this->QueryRange(root_, left, right);
+  }
+
+  void Apply(size_t left, size_t right, const TagType& tag) {
+    root_ = this->ApplyRange(root_, left, right, tag);
+    Publish();
+  }
+
+  T GetMin(size_t left, size_t right) const
+    requires std::is_same_v<Aggregate, MinAggregate<T>>
+  {
+    return Query(left, right);
+  }
+
+  void Add(size_t left, size_t right, T increment)
+    requires std::is_same_v<Tag, AddTag<T>>
+  {
+    Apply(left, right, increment);
+  }
+
+  void Assign(size_t left, size_t right, const T& value)
+    requires std::is_same_v<Tag, AssignTag<T>>
+  {
+    Apply(left, right, value);
+  }
+
+  void Reverse(size_t left, size_t right)
+    requires std::is_same_v<Tag, ReverseTag>
+  {
+    Apply(left, right, true);
+  }
+
+  T at(int64_t pos) const { return this->ValueAt(root_, pos); }
+
+ private:
+  static Node& Get(Node* node) { return *node; }
+
+  // Takes an owned reference and returns a node the writer may modify: the
+  // node itself if nobody else can see it, a private copy otherwise.
+  static Node* Own(Node* node) {
+    if (node == nullptr || node->refs.load(std::memory_order_acquire) == 1) {
+      return node;
+    }
+    Node* copy = new Node(*node);
+    Acquire(copy->left);
+    Acquire(copy->right);
+    Release(node);
+    return copy;
+  }
+
+  void Publish() {
+    Acquire(root_);
+    std::atomic_store(&published_,
+                      std::shared_ptr<const Version>(new Version(root_)));
+  }
+
+  static Node* Acquire(Node* node) {
+    if (node != nullptr) {
+      node->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+    return node;
+  }
+
+  static void Release(Node* node) {
+    if (node == nullptr ||
+        node->refs.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+      return;
+    }
+    std::vector<Node*> dead = {node};
+    while (!dead.empty()) {
+      node = dead.back();
+      dead.pop_back();
+      for (Node* child : {node->left, node->right}) {
+        if (child != nullptr &&
+            child->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+          dead.push_back(child);
+        }
+      }
+      delete node;
+    }
+  }
+
+  template <typename InputIt>
+  Node* Build(InputIt first, InputIt last) {
+    std::vector<Node*> spine;
+    for (; first != last; ++first) {
+      AppendToSpine(spine, new Node(gen_(), *first));
+    }
+    return CloseSpine(spine);
+  }
+
+  Node* root_;
+  std::shared_ptr<const Version> published_;
+};
@@ -0,0 +1,574 @@
+#include <malloc.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <random>
+#include <shared_mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "TreapArray.cpp"
+
+// Benchmarks of the TreapArray variants, one mode per change:
+//   arena [elements]        random inserts, then erase/insert churn, with
+//                           arena nodes against the original pointer-based
+//                           treap; also the heap bytes used per element
+//   persistent [size] [max readers]
+//                           range-min throughput of 1, 2, 4, ... reader
+//                           threads while one writer edits, on snapshots of
+//                           a PersistentTreapArray and on a TreapArray
+//                           behind a reader-writer lock
+//   policies [size] [operations]
+//                           node size, memory per element and the throughput
+//                           of range queries, range updates and insert/erase
+//                           for each aggregate/tag combination
+//   splitmerge [size] [operations]
+//                           iterative split/merge against the recursive
+//                           arena treap that preceded it: erase/insert
+//                           churn, random and sliding range minima, and
+//                           range adds mixed with range minima
+
+template <typename Function>
+double Measure(Function function) {
+  auto start = std::chrono::steady_clock::now();
+  function();
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
+
+size_t Argument(int argc, char** argv, int index, size_t fallback) {
+  return argc > index ? std::strtoull(argv[index], nullptr, 10) : fallback;
+}
+
+// Bytes currently taken from malloc, including blocks it mmap'd.
+size_t HeapBytes() {
+  struct mallinfo2 info = mallinfo2();
+  return info.uordblks + info.hblkhd;
+}
+
+// The treap before the arena: one heap-allocated node per element with
+// pointer links and 64-bit size and priority, recursive split and merge.
+class PointerTreap {
+  struct Node {
+    Node(int64_t priority, int64_t value)
+        : size(1), min(value), priority(priority), value(value) {}
+
+    int64_t size;
+    int64_t min;
+    int64_t priority;
+    int64_t value;
+    int64_t add = 0;
+    Node* left = nullptr;
+    Node* right = nullptr;
+  };
+
+ public:
+  PointerTreap() = default;
+
+  PointerTreap(const PointerTreap&) = delete;
+  PointerTreap& operator=(const PointerTreap&) = delete;
+
+  ~PointerTreap() { Clear(root_); }
+
+  void Insert(int64_t pos, int64_t value) {
+    Node* node = new Node(distribution_(gen_), value);
+    auto [first, second] = Split(root_, pos);
+    root_ = Merge(Merge(first, node), second);
+  }
+
+  void Erase(int64_t pos) {
+    auto [left, right_with_pos] = Split(root_, pos);
+    auto [pos_tree, right] = Split(right_with_pos, 1);
+    delete pos_tree;
+    root_ = Merge(left, right);
+  }
+
+ private:
+  static void Clear(Node* node) {
+    if (node != nullptr) {
+      Clear(node->left);
+      Clear(node->right);
+      delete node;
+    }
+  }
+
+  static Node* Merge(Node* first, Node* second) {
+    Push(first);
+    Push(second);
+    if (first == nullptr) {
+      return second;
+    }
+    if (second == nullptr) {
+      return first;
+    }
+    if (first->priority > second->priority) {
+      first->right = Merge(first->right, second);
+      Update(first);
+      return first;
+    }
+    second->left = Merge(first, second->left);
+    Update(second);
+    return second;
+  }
+
+  static std::pair<Node*, Node*> Split(Node* node, int64_t pos) {
+    if (node == nullptr) {
+      return {nullptr, nullptr};
+    }
+    Push(node);
+    int64_t left_size = Size(node->left);
+    if (pos <= left_size) {
+      auto [left, right] = Split(node->left, pos);
+      node->left = right;
+      Update(node);
+      return {left, node};
+    }
+    auto [left, right] = Split(node->right, pos - left_size - 1);
+    node->right = left;
+    Update(node);
+    return {node, right};
+  }
+
+  static void Update(Node* node) {
+    node->size = 1 + Size(node->left) + Size(node->right);
+    node->min = node->value;
+    for (Node* child : {node->left, node->right}) {
+      if (child != nullptr) {
+        Push(child);
+        node->min = std::min(node->min, child->min);
+      }
+    }
+  }
+
+  static void Push(Node* node) {
+    if (node == nullptr || node->add == 0) {
+      return;
+    }
+    for (Node* child : {node->left, node->right}) {
+      if (child != nullptr) {
+        child->add += node->add;
+      }
+    }
+    node->min += node->add;
+    node->value += node->add;
+    node->add = 0;
+  }
+
+  static int64_t Size(const Node* node) {
+    return node == nullptr ? 0 : node->size;
+  }
+
+  Node* root_ = nullptr;
+  std::mt19937 gen_;
+  std::uniform_int_distribution<int64_t> distribution_;
+};
+
+// `count` inserts at random positions, then count / 2 erase/insert pairs.
+template <typename Treap>
+void RunArena(const char* name, size_t count) {
+  std::mt19937_64 generator(1);
+  size_t before = HeapBytes();
+  size_t bytes = 0;
+  double insert_seconds = 0;
+  double churn_seconds = 0;
+  {
+    Treap treap;
+    insert_seconds = Measure([&] {
+      for (size_t i = 0; i < count; ++i) {
+        treap.Insert(generator() % (i + 1), generator());
+      }
+    });
+    bytes = HeapBytes() - before;
+    churn_seconds = Measure([&] {
+      for (size_t i = 0; i < count / 2; ++i) {
+        treap.Erase(generator() % count);
+        treap.Insert(generator() % count, generator());
+      }
+    });
+  }
+  std::printf("%-16s %14.1f %14.0f %14.0f\n", name,
+              static_cast<double>(bytes) / count, count / insert_seconds,
+              count / churn_seconds);
+}
+
+int BenchmarkArena(size_t count) {
+  std::printf("%-16s %14s %14s %14s\n", "treap", "bytes/element",
+              "inserts/s", "churn ops/s");
+  RunArena<PointerTreap>("pointer nodes", count);
+  RunArena<TreapArray<int64_t>>("arena", count);
+  return 0;
+}
+
+// The baseline: a TreapArray behind a reader-writer lock, whose "snapshot"
+// always reads the latest version.
+class LockedTreap {
+ public:
+  class View {
+   public:
+    explicit View(LockedTreap* treap) : treap_(treap) {}
+
+    int64_t GetMin(size_t left, size_t right) const {
+      std::shared_lock lock(treap_->mutex_);
+      return treap_->array_.Query(left, right);
+    }
+
+   private:
+    LockedTreap* treap_;
+  };
+
+  explicit LockedTreap(const std::vector<int64_t>& values) : array_(values) {}
+
+  View Snapshot() { return View(this); }
+
+  void Add(size_t left, size_t right, int64_t increment) {
+    std::unique_lock lock(mutex_);
+    array_.Add(left, right, increment);
+  }
+
+  void Insert(int64_t pos, int64_t value) {
+    std::unique_lock lock(mutex_);
+    array_.Insert(pos, value);
+  }
+
+  void Erase(int64_t pos) {
+    std::unique_lock lock(mutex_);
+    array_.Erase(pos);
+  }
+
+ private:
+  std::shared_mutex mutex_;
+  TreapArray<int64_t> array_;
+};
+
+// For a fixed time one writer adds to random ranges and inserts and erases
+// an element, while `readers` threads run range minima on snapshots that
+// they renew every kQueriesPerSnapshot queries.
+template <typename Array>
+void RunReaders(const char* name, size_t size, size_t readers) {
+  constexpr auto kDuration = std::chrono::milliseconds(500);
+  constexpr size_t kQueriesPerSnapshot = 64;
+  std::vector<int64_t> values(size);
+  std::mt19937_64 generator(1);
+  for (auto& value : values) {
+    value = generator() % 1'000'000;
+  }
+  Array array(values);
+  std::atomic<bool> stop{false};
+  std::atomic<uint64_t> queries{0};
+  // Keeps the reads from being optimized away.
+  std::atomic<int64_t> checksum{0};
+  uint64_t edits = 0;
+  std::vector<std::thread> threads;
+  for (size_t reader = 0; reader < readers; ++reader) {
+    threads.emplace_back([&, reader] {
+      std::mt19937_64 generator(reader + 2);
+      auto view = array.Snapshot();
+      uint64_t count = 0;
+      int64_t total = 0;
+      for (; !stop.load(std::memory_order_relaxed); ++count) {
+        if (count % kQueriesPerSnapshot == 0) {
+          view = array.Snapshot();
+        }
+        size_t left = generator() % size;
+        size_t right = left + generator() % (size - left);
+        total += view.GetMin(left, right);
+      }
+      queries.fetch_add(count);
+      checksum.fetch_add(total);
+    });
+  }
+  threads.emplace_back([&] {
+    for (; !stop.load(std::memory_order_relaxed); edits += 3) {
+      size_t left = generator() % size;
+      size_t right = left + generator() % (size - left);
+      array.Add(left, right, generator() % 100);
+      array.Insert(generator() % size, generator() % 1'000'000);
+      array.Erase(generator() % size);
+    }
+  });
+  std::this_thread::sleep_for(kDuration);
+  stop = true;
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  std::chrono::duration<double> seconds = kDuration;
+  std::printf("%-12s %8zu %16.0f %16.0f\n", name, readers,
+              queries / seconds.count(), edits / seconds.count());
+}
+
+int BenchmarkPersistent(size_t size, size_t max_readers) {
+  std::printf("%-12s %8s %16s %16s\n", "treap", "readers", "queries/s",
+              "edits/s");
+  for (size_t readers = 1; readers <= max_readers; readers *= 2) {
+    RunReaders<LockedTreap>("locked", size, readers);
+    RunReaders<PersistentTreapArray<int64_t>>("persistent", size, readers);
+  }
+  return 0;
+}
+
+// A random range update of kind Tag.
+template <typename Tag, typename Generator>
+typename Tag::Type RandomTag(Generator& generator) {
+  if constexpr (std::is_same_v<Tag, ReverseTag>) {
+    return true;
+  } else if constexpr (std::is_same_v<Tag, NoTag>) {
+    return {};
+  } else {
+    return static_cast<int64_t>(generator() % 100);
+  }
+}
+
+// `operations` rounds of one range query, one range update and one
+// erase/insert pair on an array of `size` random values.
+template <typename Aggregate, typename Tag>
+void RunPolicy(const char* name, size_t size, size_t operations) {
+  using Array = TreapArray<int64_t, Aggregate, Tag>;
+  std::mt19937_64 generator(1);
+  std::vector<int64_t> values(size);
+  for (auto& value : values) {
+    value = generator() % 1'000'000;
+  }
+  Array array(values);
+  size_t memory = array.MemoryUsage();
+  int64_t total = 0;
+  double seconds = Measure([&] {
+    for (size_t i = 0; i < operations; ++i) {
+      size_t left = generator() % size;
+      size_t right = left + generator() % (size - left);
+      auto aggregate = array.Query(left, right);
+      if constexpr (!std::is_same_v<Aggregate, NoAggregate>) {
+        total += aggregate;
+      }
+      left = generator() % size;
+      right = left + generator() % (size - left);
+      array.Apply(left, right, RandomTag<Tag>(generator));
+      array.Erase(generator() % size);
+      array.Insert(generator() % size, generator() % 1'000'000);
+    }
+  });
+  std::printf("%-20s %10zu %14.1f %14.0f %s\n", name,
+              sizeof(TreapNode<int64_t, Aggregate, Tag, uint32_t>),
+              static_cast<double>(memory) / size, operations / seconds,
+              total < 0 ? "negative sum" : "");
+}
+
+int BenchmarkPolicies(size_t size, size_t operations) {
+  std::printf("%-20s %10s %14s %14s\n", "policies", "node bytes",
+              "bytes/element", "rounds/s");
+  RunPolicy<MinAggregate<int64_t>, AddTag<int64_t>>("min + add", size,
+                                                    operations);
+  RunPolicy<SumAggregate<int64_t>, AddTag<int64_t>>("sum + add", size,
+                                                    operations);
+  RunPolicy<SumAggregate<int64_t>, AssignTag<int64_t>>("sum + assign", size,
+                                                       operations);
+  RunPolicy<MaxAggregate<int64_t>, AssignTag<int64_t>>("max + assign", size,
+                                                       operations);
+  RunPolicy<NoAggregate, ReverseTag>("reverse", size, operations);
+  RunPolicy<NoAggregate, NoTag>("none", size, operations);
+  return 0;
+}
+
+// The arena treap before split and merge became iterative: the same node
+// layout, but recursive Split/Merge, and range minima and range adds that
+// split the range out and merge it back.
+class RecursiveTreap {
+  struct Node {
+    uint32_t size;
+    uint32_t priority;
+    uint32_t left;
+    uint32_t right;
+    int64_t value;
+    int64_t min;
+    int64_t add;
+  };
+
+ public:
+  explicit RecursiveTreap(const std::vector<int64_t>& values)
+      : nodes_(1, Node{}) {
+    for (size_t i = 0; i < values.size(); ++i) {
+      Insert(i, values[i]);
+    }
+  }
+
+  void Insert(int64_t pos, int64_t value) {
+    nodes_.push_back({1, static_cast<uint32_t>(gen_()), 0, 0, value, value,
+                      0});
+    uint32_t node = nodes_.size() - 1;
+    auto [first, second] = Split(root_, pos);
+    root_ = Merge(Merge(first, node), second);
+  }
+
+  // Erased nodes are not reused; the benchmark inserts as many as it erases.
+  void Erase(int64_t pos) {
+    auto [left, right_with_pos] = Split(root_, pos);
+    auto [pos_tree, right] = Split(right_with_pos, 1);
+    root_ = Merge(left, right);
+  }
+
+  int64_t GetMin(size_t left, size_t right) {
+    auto [first, rest] = Split(root_, left);
+    auto [range, second] = Split(rest, right - left + 1);
+    int64_t min = nodes_[range].min;
+    root_ = Merge(first, Merge(range, second));
+    return min;
+  }
+
+  void Add(size_t left, size_t right, int64_t increment) {
+    auto [first, rest] = Split(root_, left);
+    auto [range, second] = Split(rest, right - left + 1);
+    nodes_[range].add += increment;
+    Push(range);
+    root_ = Merge(first, Merge(range, second));
+  }
+
+ private:
+  uint32_t Merge(uint32_t first, uint32_t second) {
+    if (first == 0 || second == 0) {
+      return first + second;
+    }
+    if (nodes_[first].priority > nodes_[second].priority) {
+      Push(first);
+      nodes_[first].right = Merge(nodes_[first].right, second);
+      Update(first);
+      return first;
+    }
+    Push(second);
+    nodes_[second].left = Merge(first, nodes_[second].left);
+    Update(second);
+    return second;
+  }
+
+  std::pair<uint32_t, uint32_t> Split(uint32_t node, int64_t pos) {
+    if (node == 0) {
+      return {0, 0};
+    }
+    Push(node);
+    int64_t left_size = nodes_[nodes_[node].left].size;
+    if (pos <= left_size) {
+      auto [left, right] = Split(nodes_[node].left, pos);
+      nodes_[node].left = right;
+      Update(node);
+      return {left, node};
+    }
+    auto [left, right] = Split(nodes_[node].right, pos - left_size - 1);
+    nodes_[node].right = left;
+    Update(node);
+    return {node, right};
+  }
+
+  void Update(uint32_t node) {
+    Node& n = nodes_[node];
+    n.size = 1 + nodes_[n.left].size + nodes_[n.right].size;
+    n.min = n.value;
+    for (uint32_t child : {n.left, n.right}) {
+      if (child != 0) {
+        n.min = std::min(n.min, nodes_[child].min + nodes_[child].add);
+      }
+    }
+  }
+
+  void Push(uint32_t node) {
+    Node& n = nodes_[node];
+    if (n.add == 0) {
+      return;
+    }
+    for (uint32_t child : {n.left, n.right}) {
+      if (child != 0) {
+        nodes_[child].add += n.add;
+      }
+    }
+    n.value += n.add;
+    n.min += n.add;
+    n.add = 0;
+  }
+
+  std::vector<Node> nodes_;
+  uint32_t root_ = 0;
+  std::mt19937 gen_;
+};
+
+template <typename Treap>
+void RunSplitMerge(const char* name, size_t size, size_t operations) {
+  std::mt19937_64 generator(1);
+  std::vector<int64_t> values(size);
+  for (auto& value : values) {
+    value = generator() % 1'000'000;
+  }
+  Treap treap(values);
+  double churn_seconds = Measure([&] {
+    for (size_t i = 0; i < operations; ++i) {
+      treap.Erase(generator() % size);
+      treap.Insert(generator() % size, generator() % 1'000'000);
+    }
+  });
+  int64_t total = 0;
+  double random_seconds = Measure([&] {
+    for (size_t i = 0; i < operations; ++i) {
+      size_t left = generator() % size;
+      total += treap.GetMin(left, left + generator() % (size - left));
+    }
+  });
+  // A window of a thousand positions sliding over the array.
+  size_t window = std::min<size_t>(size, 1000);
+  double sliding_seconds = Measure([&] {
+    for (size_t i = 0; i < operations; ++i) {
+      size_t left = i % (size - window + 1);
+      total += treap.GetMin(left, left + window - 1);
+    }
+  });
+  double mixed_seconds = Measure([&] {
+    for (size_t i = 0; i < operations; ++i) {
+      size_t left = generator() % size;
+      size_t right = left + generator() % (size - left);
+      if (i % 2 == 0) {
+        treap.Add(left, right, generator() % 100);
+      } else {
+        total += treap.GetMin(left, right);
+      }
+    }
+  });
+  std::printf("%-12s %14.0f %14.0f %14.0f %14.0f %s\n", name,
+              operations / churn_seconds, operations / random_seconds,
+              operations / sliding_seconds, operations / mixed_seconds,
+              total < 0 ? "negative sum" : "");
+}
+
+int BenchmarkSplitMerge(size_t size, size_t operations) {
+  std::printf("%-12s %14s %14s %14s %14s\n", "treap", "churn pairs/s",
+              "random min/s", "sliding min/s", "add+min ops/s");
+  RunSplitMerge<RecursiveTreap>("recursive", size, operations);
+  RunSplitMerge<TreapArray<int64_t>>("iterative", size, operations);
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  const char* mode = argc > 1 ? argv[1] : "";
+  if (std::strcmp(mode, "arena") == 0) {
+    return BenchmarkArena(Argument(argc, argv, 2, 1'000'000));
+  }
+  if (std::strcmp(mode, "persistent") == 0) {
+    return BenchmarkPersistent(Argument(argc, argv, 2, 1'000'000),
+                               Argument(argc, argv, 3, DefaultThreads()));
+  }
+  if (std::strcmp(mode, "policies") == 0) {
+    return BenchmarkPolicies(Argument(argc, argv, 2, 1'000'000),
+                             Argument(argc, argv, 3, 1'000'000));
+  }
+  if (std::strcmp(mode, "splitmerge") == 0) {
+    return BenchmarkSplitMerge(Argument(argc, argv, 2, 1'000'000),
+                               Argument(argc, argv, 3, 1'000'000));
+  }
+  std::fprintf(stderr,
+               "usage: %s arena [count] | persistent [size] [readers] | "
+               "policies [size] [operations] | "
+               "splitmerge [size] [operations]\n",
+               argv[0]);
+  return 1;
+}
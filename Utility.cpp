@@ -1,21 +1,26 @@
-#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
 #include <string>
+#include <vector>
 
+#include "CoordinateCompression.h"
+
+// Replaces the segment ends by their ranks 1 .. k among the k distinct ends.
 template <typename T, typename V>
 void CompressValues(std::vector<T>& values) {
-  std::vector<V> tmp;
-  for (auto seg : values) {
-    tmp.emplace_back(seg.l);
-    tmp.emplace_back(seg.r);
+  std::vector<V> ends;
+  ends.reserve(2 * values.size());
+  for (const auto& seg : values) {
+    ends.emplace_back(seg.l);
+    ends.emplace_back(seg.r);
   }
+  std::vector<uint32_t> ranks(ends.size());
+  CompressCoordinates<V>(ends, ranks);
 
-  std::sort(tmp.begin(), tmp.end());
-  auto last = std::unique(tmp.begin(), tmp.end());
-  tmp.erase(last, tmp.end());
-
-  for (auto& v : values) {
-    v.l = std::lower_bound(tmp.begin(), tmp.end(), v.l) - tmp.begin() + 1;
-    v.r = std::lower_bound(tmp.begin(), tmp.end(), v.r) - tmp.begin() + 1;
+  for (size_t i = 0; i < values.size(); ++i) {
+    values[i].l = ranks[2 * i];
+    values[i].r = ranks[2 * i + 1];
   }
 }
 